@@ -17,6 +17,7 @@ static const char ca_cert[] = {
 };
 
 BridgeTCPClient<> client(Bridge);
+BridgeCAHandle ca_handle;
 
 void setup() {
 
@@ -28,13 +29,23 @@ void setup() {
     while (true) {}
   }
 
+  /* Send the certificate to the router once, then connect with its handle.
+   * The bridge registers it again by itself if the router restarts */
+  if (!Bridge.registerCA(ca_cert, ca_handle)) {
+    Monitor.println("CA registration not supported, the certificate will be sent on every connection");
+  }
+
 }
 
 void loop() {
   Monitor.println("\nStarting connection to server...");
 
   /* if you get a connection, report back via monitor: */
-  if (client.connectSSL("arduino.tips", 443, ca_cert) < 0) {
+  const int res = ca_handle.valid?
+    client.connectSSL("arduino.tips", 443, ca_handle, TLS_OPT_RESUME_SESSION) :
+    client.connectSSL("arduino.tips", 443, ca_cert);
+
+  if (res < 0) {
     Monitor.println("unable to connect to server");
     return;
   }
@@ -63,5 +63,13 @@ void loop() {
         Serial.println(outcome.getErrorMessage());
     }
 
+    // Returns at once: the callback runs in the bridge thread when the response arrives
+    Bridge.call_async("multiply", [](float product, const RpcError& error) {
+        if (error.code == NO_ERR) {
+            Serial.print("Async result: ");
+            Serial.println(product);
+        }
+    }, 2.0, 3.0);
+
     Bridge.notify("signal", 200);
 }
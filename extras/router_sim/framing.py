@@ -0,0 +1,80 @@
+"""
+Link framing matching BRIDGE_FRAMED_LINK in src/framed_link.h.
+
+    A5 5A | len lo | len hi | len lo ^ len hi ^ 55 | payload | CRC-16/CCITT-FALSE of len and payload, big endian
+
+A frame failing its checks is dropped and the search for the next sync marker restarts one
+byte after the bad one, inside the bytes already received.
+"""
+
+SYNC = b"\xa5\x5a"
+HEADER = 5
+TRAILER = 2
+
+
+def crc16(data, crc=0xFFFF):
+    for b in data:
+        crc ^= b << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021) & 0xFFFF if crc & 0x8000 else (crc << 1) & 0xFFFF
+    return crc
+
+
+def encode_frame(payload):
+    size = len(payload)
+    if size > 0xFFFF:
+        raise ValueError("frame payload too long")
+    length = bytes((size & 0xFF, size >> 8))
+    crc = crc16(payload, crc16(length))
+    return SYNC + length + bytes((length[0] ^ length[1] ^ 0x55,)) + bytes(payload) + bytes((crc >> 8, crc & 0xFF))
+
+
+class Deframer:
+    """feed() raw link bytes, get back the payloads of the good frames"""
+
+    def __init__(self, max_payload=0xFFFF):
+        self.max_payload = max_payload
+        self._buf = bytearray()
+        self.dropped = 0        # frames lost after a good sync marker: bad header or CRC
+        self.skipped = 0        # bytes outside any frame
+
+    def feed(self, data):
+        self._buf += data
+        out = []
+        while True:
+            start = self._buf.find(SYNC[:1])
+            if start < 0:
+                self.skipped += len(self._buf)
+                self._buf.clear()
+                return out
+            if start:
+                self.skipped += start
+                del self._buf[:start]
+            if len(self._buf) < HEADER:
+                if len(self._buf) >= 2 and self._buf[1] != SYNC[1]:
+                    self._skip()
+                    continue
+                return out
+            size = self._buf[2] | self._buf[3] << 8
+            if self._buf[1] != SYNC[1]:
+                self._skip()
+                continue
+            if self._buf[4] != self._buf[2] ^ self._buf[3] ^ 0x55 or size > self.max_payload:
+                self.dropped += 1
+                self._skip()
+                continue
+            end = HEADER + size + TRAILER
+            if len(self._buf) < end:
+                return out
+            payload = bytes(self._buf[HEADER:HEADER + size])
+            crc = crc16(payload, crc16(self._buf[2:4]))
+            if self._buf[end - 2] == crc >> 8 and self._buf[end - 1] == crc & 0xFF:
+                out.append(payload)
+                del self._buf[:end]
+            else:
+                self.dropped += 1
+                self._skip()
+
+    def _skip(self):
+        self.skipped += 1
+        del self._buf[:1]
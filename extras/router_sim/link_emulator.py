@@ -0,0 +1,150 @@
+"""
+UART link emulator for the router simulator.
+
+Every byte crossing the link, in either direction, is delayed by its time on the wire
+(10 bits per byte at the configured baud rate) plus a fixed latency and a random jitter,
+and can be dropped or have one bit flipped. Bytes are never reordered, as on a real UART.
+All randomness comes from a seeded generator, so a run can be replayed exactly.
+"""
+
+import os
+import random
+import threading
+import time
+from collections import deque
+from dataclasses import dataclass
+
+
+@dataclass
+class LinkConfig:
+    baud: int = 0               # 0: no wire time
+    latency_us: float = 0.0     # added to every byte
+    jitter_us: float = 0.0      # uniform in [0, jitter_us]
+    loss: float = 0.0           # probability of dropping a byte
+    corruption: float = 0.0     # probability of flipping one bit of a byte
+    seed: int = 0
+
+
+@dataclass
+class LinkStats:
+    bytes: int = 0
+    lost: int = 0
+    corrupted: int = 0
+
+
+class _Direction:
+    """One way of the link: bytes go in with push() and come out of deliver(data) on time"""
+
+    def __init__(self, config, rng, deliver):
+        self.config = config
+        self.rng = rng
+        self.deliver = deliver
+        self.stats = LinkStats()
+        self.byte_time = 10.0 / config.baud if config.baud > 0 else 0.0
+        self.wire_free = 0.0        # when the wire finishes sending the last byte
+        self.last_arrival = 0.0
+        self.queue = deque()        # (arrival time, byte)
+        self.cond = threading.Condition()
+        self.closed = False
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def push(self, data):
+        now = time.monotonic()
+        cfg = self.config
+        with self.cond:
+            for b in data:
+                self.stats.bytes += 1
+                self.wire_free = max(self.wire_free, now) + self.byte_time
+                if cfg.loss and self.rng.random() < cfg.loss:
+                    self.stats.lost += 1
+                    continue
+                if cfg.corruption and self.rng.random() < cfg.corruption:
+                    b ^= 1 << self.rng.randrange(8)
+                    self.stats.corrupted += 1
+                delay = cfg.latency_us
+                if cfg.jitter_us:
+                    delay += self.rng.uniform(0.0, cfg.jitter_us)
+                arrival = max(self.wire_free + delay / 1e6, self.last_arrival)
+                self.last_arrival = arrival
+                self.queue.append((arrival, b))
+            self.cond.notify()
+
+    def close(self):
+        with self.cond:
+            self.closed = True
+            self.cond.notify()
+
+    def _run(self):
+        while True:
+            with self.cond:
+                while not self.queue and not self.closed:
+                    self.cond.wait()
+                if self.closed:
+                    return
+                wait = self.queue[0][0] - time.monotonic()
+                if wait > 0:
+                    self.cond.wait(wait)
+                    continue
+                now = time.monotonic()
+                due = bytearray()
+                while self.queue and self.queue[0][0] <= now:
+                    due.append(self.queue.popleft()[1])
+            self.deliver(bytes(due))
+
+
+class LinkEmulator:
+    """Sits between a file descriptor (pty master, socket, serial device) and the router.
+
+    write() sends towards the MCU through the emulated link; bytes coming from the MCU are
+    passed through the link as well and then handed to on_receive(data).
+    """
+
+    def __init__(self, fd, on_receive, config=None):
+        self.fd = fd
+        self.config = config or LinkConfig()
+        # one generator per direction keeps each side reproducible on its own
+        self.tx = _Direction(self.config, random.Random(self.config.seed * 2 + 1), self._write_fd)
+        self.rx = _Direction(self.config, random.Random(self.config.seed * 2 + 2), on_receive)
+        self.running = True
+        self.reader = threading.Thread(target=self._read_fd, daemon=True)
+        self.reader.start()
+
+    def write(self, data):
+        self.tx.push(data)
+
+    def close(self):
+        self.running = False
+        self.tx.close()
+        self.rx.close()
+
+    def stats(self):
+        return {"to_mcu": self.tx.stats, "from_mcu": self.rx.stats}
+
+    def _write_fd(self, data):
+        view = memoryview(data)
+        while view:
+            try:
+                n = os.write(self.fd, view)
+            except BlockingIOError:
+                time.sleep(0.0005)
+                continue
+            except OSError:
+                return
+            view = view[n:]
+
+    def _read_fd(self):
+        while self.running:
+            try:
+                data = os.read(self.fd, 4096)
+            except BlockingIOError:
+                time.sleep(0.0005)
+                continue
+            except OSError:
+                # pty without a peer yet, or the peer went away
+                time.sleep(0.05)
+                continue
+            if not data:
+                time.sleep(0.05)
+                continue
+            self.rx.push(data)
@@ -0,0 +1,228 @@
+"""
+Minimal pure-Python MessagePack codec, enough for the msgpack-rpc traffic of the bridge.
+
+Kept dependency free so the router simulator runs on any stock Python 3.
+Supports nil, bool, int, float32/64, str, bin, array and map; ext types are rejected.
+"""
+
+import struct
+
+
+class OutOfData(Exception):
+    """The buffer ends in the middle of an object"""
+
+
+class FormatError(Exception):
+    """The buffer does not hold MessagePack data"""
+
+
+def packb(obj):
+    out = bytearray()
+    _pack(obj, out)
+    return bytes(out)
+
+
+def _pack(obj, out):
+    if obj is None:
+        out.append(0xC0)
+    elif obj is True:
+        out.append(0xC3)
+    elif obj is False:
+        out.append(0xC2)
+    elif isinstance(obj, int):
+        _pack_int(obj, out)
+    elif isinstance(obj, float):
+        out.append(0xCB)
+        out += struct.pack(">d", obj)
+    elif isinstance(obj, str):
+        data = obj.encode("utf-8")
+        n = len(data)
+        if n < 32:
+            out.append(0xA0 | n)
+        elif n < 0x100:
+            out += bytes((0xD9, n))
+        elif n < 0x10000:
+            out += b"\xda" + struct.pack(">H", n)
+        else:
+            out += b"\xdb" + struct.pack(">I", n)
+        out += data
+    elif isinstance(obj, (bytes, bytearray, memoryview)):
+        data = bytes(obj)
+        n = len(data)
+        if n < 0x100:
+            out += bytes((0xC4, n))
+        elif n < 0x10000:
+            out += b"\xc5" + struct.pack(">H", n)
+        else:
+            out += b"\xc6" + struct.pack(">I", n)
+        out += data
+    elif isinstance(obj, (list, tuple)):
+        n = len(obj)
+        if n < 16:
+            out.append(0x90 | n)
+        elif n < 0x10000:
+            out += b"\xdc" + struct.pack(">H", n)
+        else:
+            out += b"\xdd" + struct.pack(">I", n)
+        for item in obj:
+            _pack(item, out)
+    elif isinstance(obj, dict):
+        n = len(obj)
+        if n < 16:
+            out.append(0x80 | n)
+        elif n < 0x10000:
+            out += b"\xde" + struct.pack(">H", n)
+        else:
+            out += b"\xdf" + struct.pack(">I", n)
+        for key, value in obj.items():
+            _pack(key, out)
+            _pack(value, out)
+    else:
+        raise TypeError(f"cannot pack {type(obj).__name__}")
+
+
+def _pack_int(n, out):
+    if 0 <= n < 0x80:
+        out.append(n)
+    elif -32 <= n < 0:
+        out.append(n & 0xFF)
+    elif n >= 0:
+        if n < 0x100:
+            out += bytes((0xCC, n))
+        elif n < 0x10000:
+            out += b"\xcd" + struct.pack(">H", n)
+        elif n < 0x100000000:
+            out += b"\xce" + struct.pack(">I", n)
+        else:
+            out += b"\xcf" + struct.pack(">Q", n)
+    else:
+        if n >= -0x80:
+            out += b"\xd0" + struct.pack(">b", n)
+        elif n >= -0x8000:
+            out += b"\xd1" + struct.pack(">h", n)
+        elif n >= -0x80000000:
+            out += b"\xd2" + struct.pack(">i", n)
+        else:
+            out += b"\xd3" + struct.pack(">q", n)
+
+
+_FIXED = {
+    0xCC: ">B", 0xCD: ">H", 0xCE: ">I", 0xCF: ">Q",
+    0xD0: ">b", 0xD1: ">h", 0xD2: ">i", 0xD3: ">q",
+    0xCA: ">f", 0xCB: ">d",
+}
+
+
+def _unpack(buf, pos):
+    """Decodes one object at pos. Returns (object, next position)"""
+    if pos >= len(buf):
+        raise OutOfData()
+    b = buf[pos]
+    pos += 1
+
+    if b < 0x80:
+        return b, pos
+    if b >= 0xE0:
+        return b - 0x100, pos
+    if 0xA0 <= b <= 0xBF:
+        return _take_str(buf, pos, b & 0x1F)
+    if 0x90 <= b <= 0x9F:
+        return _take_array(buf, pos, b & 0x0F)
+    if 0x80 <= b <= 0x8F:
+        return _take_map(buf, pos, b & 0x0F)
+    if b == 0xC0:
+        return None, pos
+    if b == 0xC2:
+        return False, pos
+    if b == 0xC3:
+        return True, pos
+    if b in _FIXED:
+        fmt = _FIXED[b]
+        size = struct.calcsize(fmt)
+        _need(buf, pos, size)
+        return struct.unpack_from(fmt, buf, pos)[0], pos + size
+    if b in (0xC4, 0xC5, 0xC6):
+        n, pos = _take_len(buf, pos, b - 0xC4)
+        _need(buf, pos, n)
+        return bytes(buf[pos:pos + n]), pos + n
+    if b in (0xD9, 0xDA, 0xDB):
+        n, pos = _take_len(buf, pos, b - 0xD9)
+        return _take_str(buf, pos, n)
+    if b in (0xDC, 0xDD):
+        n, pos = _take_len(buf, pos, b - 0xDC + 1)
+        return _take_array(buf, pos, n)
+    if b in (0xDE, 0xDF):
+        n, pos = _take_len(buf, pos, b - 0xDE + 1)
+        return _take_map(buf, pos, n)
+    raise FormatError(f"unsupported type byte 0x{b:02x}")
+
+
+def _need(buf, pos, n):
+    if pos + n > len(buf):
+        raise OutOfData()
+
+
+def _take_len(buf, pos, width_index):
+    fmt = (">B", ">H", ">I")[width_index]
+    size = struct.calcsize(fmt)
+    _need(buf, pos, size)
+    return struct.unpack_from(fmt, buf, pos)[0], pos + size
+
+
+def _take_str(buf, pos, n):
+    _need(buf, pos, n)
+    return bytes(buf[pos:pos + n]).decode("utf-8", errors="replace"), pos + n
+
+
+def _take_array(buf, pos, n):
+    items = []
+    for _ in range(n):
+        item, pos = _unpack(buf, pos)
+        items.append(item)
+    return items, pos
+
+
+def _take_map(buf, pos, n):
+    items = {}
+    for _ in range(n):
+        key, pos = _unpack(buf, pos)
+        value, pos = _unpack(buf, pos)
+        if isinstance(key, list):
+            key = tuple(key)
+        items[key] = value
+    return items, pos
+
+
+def unpackb(data):
+    obj, pos = _unpack(data, 0)
+    if pos != len(data):
+        raise FormatError("extra bytes after the object")
+    return obj
+
+
+class Unpacker:
+    """Streaming decoder: feed() bytes as they come, iterate to get complete objects"""
+
+    def __init__(self):
+        self._buf = bytearray()
+
+    def feed(self, data):
+        self._buf += data
+
+    def buffered(self):
+        return len(self._buf)
+
+    def skip_byte(self):
+        """Drops the first buffered byte, to resync after garbage"""
+        del self._buf[:1]
+
+    def __iter__(self):
+        return self
+
+    def __next__(self):
+        try:
+            obj, pos = _unpack(self._buf, 0)
+        except OutOfData:
+            raise StopIteration
+        del self._buf[:pos]
+        return obj
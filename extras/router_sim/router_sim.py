@@ -0,0 +1,1010 @@
+#!/usr/bin/env python3
+"""
+Stand-in router for host testing of Arduino_RouterBridge.
+
+Speaks msgpack-rpc over a pty, a serial device or a socketpair, through an emulated UART
+link (see link_emulator.py), and implements the methods used by the library:
+$/reset, $/register, $/registerBatch, $/version, $/capabilities, tcp/*, udp/*, mon/*, hci/*
+and splice/*. After restart() it notifies $/hello, like a real router coming back up.
+TCP and UDP are backed by real host sockets; the monitor is the simulator's stdin/stdout;
+HCI is a fake controller answering the basic commands.
+
+Usage:
+    python3 router_sim.py --pty --baud 115200 --latency-us 50 --jitter-us 20 --seed 1
+    python3 router_sim.py --device /dev/ttyACM0 --device-baud 115200
+    python3 router_sim.py --pty --bench loopback --bench-args '["ping"]' --bench-count 1000
+
+Python methods can be served to the MCU with Router.provide(name, func), and methods the
+MCU provides can be called with Router.call(name, *args), like an App would.
+"""
+
+import argparse
+import json
+import os
+import queue
+import select
+import socket
+import ssl
+import struct
+import sys
+import termios
+import threading
+import time
+import tty
+from collections import defaultdict
+
+from framing import Deframer, encode_frame
+from link_emulator import LinkConfig, LinkEmulator
+from msgpack_lite import FormatError, Unpacker, packb
+
+REQUEST, RESPONSE, NOTIFY = 0, 1, 2
+
+# Error codes, as in Arduino_RPClite
+MALFORMED_CALL_ERR = 0xFD
+FUNCTION_NOT_FOUND_ERR = 0xFE
+GENERIC_ERR = 0xFF
+
+PROTOCOL_LEGACY, PROTOCOL_VERSIONED, PROTOCOL_CAPABLE = 0, 1, 2
+
+# A partial object stuck in the decoder for this long is treated as garbage
+RESYNC_MS = 100
+
+# splice/start options and the Monitor endpoint, as in splice.h
+SPLICE_OPT_BIDIRECTIONAL = 0x01
+SPLICE_OPT_CLOSE_ON_EOF = 0x02
+SPLICE_MONITOR_ID = 0xFFFFFFFF
+
+# conn/poll interests and events, as in poll_set.h
+POLL_READ = 0x01
+POLL_WRITE = 0x02
+POLL_CLOSED = 0x04
+POLL_INVALID = 0x08
+POLL_STEP_S = 0.005
+
+
+class RpcFault(Exception):
+    def __init__(self, code, message):
+        super().__init__(message)
+        self.code = code
+        self.message = message
+
+
+class Lane:
+    """Serves requests one at a time, in arrival order. Requests on the same connection
+    share a lane, so frames of one stream are never reordered"""
+
+    def __init__(self, name):
+        self.jobs = queue.Queue()
+        self.thread = threading.Thread(target=self._run, name=name, daemon=True)
+        self.thread.start()
+
+    def submit(self, job):
+        self.jobs.put(job)
+
+    def _run(self):
+        while True:
+            self.jobs.get()()
+
+
+class Stats:
+    def __init__(self):
+        self.lock = threading.Lock()
+        self.calls = defaultdict(int)
+        self.errors = defaultdict(int)
+        self.payload = defaultdict(int)
+        self.service = defaultdict(list)
+        self.garbage = 0
+
+    def record(self, method, seconds, error, payload=0):
+        with self.lock:
+            self.calls[method] += 1
+            if error:
+                self.errors[method] += 1
+            self.payload[method] += payload
+            self.service[method].append(seconds)
+
+    def report(self, out=sys.stderr, elapsed=None):
+        with self.lock:
+            print("method                          calls  errors     bytes  p50 ms  p99 ms", file=out)
+            for method in sorted(self.calls):
+                times = sorted(self.service[method])
+                print(f"{method:30} {self.calls[method]:6} {self.errors[method]:7} {self.payload[method]:9}"
+                      f" {percentile(times, 50) * 1e3:7.2f} {percentile(times, 99) * 1e3:7.2f}", file=out)
+                if elapsed and self.payload[method]:
+                    print(f"{'':30} {self.payload[method] / elapsed:.0f} B/s", file=out)
+            if self.garbage:
+                print(f"discarded {self.garbage} undecodable messages", file=out)
+
+
+def percentile(sorted_values, p):
+    if not sorted_values:
+        return 0.0
+    index = min(len(sorted_values) - 1, int(round(p / 100.0 * (len(sorted_values) - 1))))
+    return sorted_values[index]
+
+
+def as_bytes(data):
+    # BinaryView payloads arrive as bin, ArrayView ones as an array of ints
+    if isinstance(data, (bytes, bytearray)):
+        return bytes(data)
+    if isinstance(data, str):
+        return data.encode("latin-1")
+    return bytes(data)
+
+
+class FakeHCIController:
+    """Answers HCI commands with Command Complete events, enough for bring-up tests"""
+
+    READ_LOCAL_VERSION = 0x1001
+    RESET = 0x0C03
+
+    def __init__(self):
+        self.events = queue.Queue()
+        self.open = False
+
+    def send(self, packet):
+        if len(packet) >= 4 and packet[0] == 0x01:
+            opcode = packet[1] | (packet[2] << 8)
+            if opcode == self.READ_LOCAL_VERSION:
+                params = bytes((0x00, 0x0B)) + struct.pack("<H", 0) + bytes((0x0B,)) + struct.pack("<HH", 0x005D, 0)
+            elif opcode == self.RESET:
+                params = bytes((0x00,))
+            else:
+                params = bytes((0x01,))     # unknown HCI command
+            body = bytes((0x01,)) + struct.pack("<H", opcode) + params
+            self.events.put(bytes((0x04, 0x0E, len(body))) + body)
+        return len(packet)
+
+    def recv(self, max_size):
+        try:
+            return self.events.get_nowait()[:max_size]
+        except queue.Empty:
+            return b""
+
+    def available(self):
+        return not self.events.empty()
+
+
+class SpliceEndpoint:
+    """Uniform read/write over a tcp connection, a udp socket or the Monitor"""
+
+    def __init__(self, router, endpoint_id):
+        self.router = router
+        self.id = endpoint_id
+        self.sock = None
+        self.udp = None
+        if endpoint_id == SPLICE_MONITOR_ID:
+            return
+        if endpoint_id in router.tcp:
+            self.sock = router.tcp[endpoint_id]
+        elif endpoint_id in router.udp:
+            self.udp = router.udp[endpoint_id]
+            self.sock = self.udp["sock"]
+        else:
+            raise RpcFault(GENERIC_ERR, f"unknown connection {endpoint_id}")
+
+    def read(self):
+        """Bytes available now, b"" if none, None once the peer closed"""
+        if self.sock is None:
+            return self.router.mon_read(4096)
+        ready, _, _ = select.select([self.sock], [], [], 0)
+        if not ready:
+            return b""
+        if self.udp is not None:
+            data, peer = self.sock.recvfrom(65535)
+            if self.udp["target"] is None:
+                self.udp["target"] = peer
+            return data
+        try:
+            data = self.sock.recv(4096)
+        except (BlockingIOError, ssl.SSLWantReadError):
+            return b""
+        return data if data else None
+
+    def write(self, data):
+        if self.sock is None:
+            self.router.mon_write(data)
+        elif self.udp is not None:
+            if self.udp["target"] is not None:
+                self.sock.sendto(data, self.udp["target"])
+        else:
+            self.sock.setblocking(True)
+            try:
+                self.sock.sendall(data)
+            finally:
+                self.sock.setblocking(False)
+
+    def close(self):
+        if self.sock is not None and self.udp is None:
+            self.router.tcp_close(self.id)
+
+
+class Splice:
+    """Forwards between two endpoints in its own thread, so the bytes never reach the MCU"""
+
+    def __init__(self, src, dst, options):
+        self.src = src
+        self.dst = dst
+        self.options = options
+        self.forwarded = 0
+        self.returned = 0
+        self.active = True
+        self.stop_event = threading.Event()
+        self.thread = threading.Thread(target=self._run, daemon=True)
+        self.thread.start()
+
+    def stats(self):
+        # BridgeSpliceStats: active, forwarded, returned
+        return [self.active, self.forwarded, self.returned]
+
+    def stop(self):
+        self.stop_event.set()
+        self.thread.join()
+        return self.stats()
+
+    def _pump(self, src, dst):
+        data = src.read()
+        if data is None:
+            return None
+        if data:
+            dst.write(data)
+        return len(data)
+
+    def _run(self):
+        bidirectional = self.options & SPLICE_OPT_BIDIRECTIONAL
+        try:
+            while not self.stop_event.is_set():
+                moved = self._pump(self.src, self.dst)
+                back = self._pump(self.dst, self.src) if bidirectional else 0
+                if moved is None or back is None:
+                    if self.options & SPLICE_OPT_CLOSE_ON_EOF:
+                        self.src.close()
+                        self.dst.close()
+                    break
+                self.forwarded += moved
+                self.returned += back
+                if not moved and not back:
+                    time.sleep(0.001)
+        except OSError:
+            pass
+        self.active = False
+
+
+class Router:
+
+    def __init__(self, link_config=None, protocol=PROTOCOL_CAPABLE, version="router-sim-1.0",
+                 max_frame=256, bin_payloads=True, batching=True, echo_monitor=True, framed=False):
+        self.link_config = link_config or LinkConfig()
+        self.protocol = protocol
+        self.version = version
+        self.max_frame = max_frame
+        self.bin_payloads = bin_payloads
+        self.batching = batching
+        self.echo_monitor = echo_monitor
+        self.deframer = Deframer() if framed else None     # BRIDGE_FRAMED_LINK on the MCU
+
+        self.link = None
+        self.unpacker = Unpacker()
+        self.rx_lock = threading.Lock()
+        self.tx_lock = threading.Lock()
+        self.last_progress = time.monotonic()
+        self.down_until = 0.0
+
+        self.stats = Stats()
+        self.lanes = {}
+        self.lanes_lock = threading.Lock()
+
+        self.app_methods = {}           # served by Python, callable from the MCU
+        self.mcu_methods = set()        # registered by the MCU, callable from Python
+        self.pending = {}               # msg_id -> [event, error, result]
+        self.next_msg_id = 1
+        self.call_latency = []
+
+        self.next_id = 1
+        self.tcp = {}
+        self.listeners = {}
+        self.udp = {}
+        self.cas = {}
+        self.monitor_in = bytearray()
+        self.monitor_out = bytearray()
+        self.hci = FakeHCIController()
+        self.splices = {}
+        self.state_lock = threading.RLock()
+
+        self.methods = {
+            "$/reset": self.reset,
+            "$/register": self.register,
+            "$/registerBatch": self.register_batch,
+            "$/version": self.get_version,
+            "$/capabilities": self.get_capabilities,
+            "tcp/connect": self.tcp_connect,
+            "tcp/connectSSL": self.tcp_connect_ssl,
+            "tcp/connectSSLWithCA": self.tcp_connect_ssl_ca,
+            "tcp/registerCA": self.tcp_register_ca,
+            "tcp/unregisterCA": self.tcp_unregister_ca,
+            "tcp/close": self.tcp_close,
+            "tcp/write": self.tcp_write,
+            "tcp/read": self.tcp_read,
+            "tcp/listen": self.tcp_listen,
+            "tcp/accept": self.tcp_accept,
+            "tcp/closeListener": self.tcp_close_listener,
+            "udp/connect": self.udp_connect,
+            "udp/connectMulticast": self.udp_connect,
+            "udp/close": self.udp_close,
+            "udp/beginPacket": self.udp_begin_packet,
+            "udp/write": self.udp_write,
+            "udp/endPacket": self.udp_end_packet,
+            "udp/awaitPacket": self.udp_await_packet,
+            "udp/read": self.udp_read,
+            "udp/dropPacket": self.udp_drop_packet,
+            "mon/connected": lambda: True,
+            "mon/reset": self.mon_reset,
+            "mon/read": self.mon_read,
+            "mon/write": self.mon_write,
+            "hci/open": self.hci_open,
+            "hci/close": self.hci_close,
+            "hci/send": self.hci_send,
+            "hci/recv": self.hci_recv,
+            "hci/avail": self.hci.available,
+            "splice/start": self.splice_start,
+            "splice/stats": self.splice_stats,
+            "splice/stop": self.splice_stop,
+            "conn/poll": self.conn_poll,
+        }
+
+    # ---- transports ----
+
+    def attach(self, fd):
+        os.set_blocking(fd, False)
+        self.link = LinkEmulator(fd, self._on_bytes, self.link_config)
+        threading.Thread(target=self._resync_watchdog, daemon=True).start()
+
+    def open_pty(self):
+        master, slave = os.openpty()
+        tty.setraw(slave)
+        self.attach(master)
+        self._pty_slave = slave     # keeps the pty alive with no MCU side attached
+        return os.ttyname(slave)
+
+    def open_device(self, path, baud):
+        fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        tty.setraw(fd)
+        attrs = termios.tcgetattr(fd)
+        speed = getattr(termios, f"B{baud}")
+        attrs[4] = attrs[5] = speed
+        termios.tcsetattr(fd, termios.TCSANOW, attrs)
+        self.attach(fd)
+
+    def open_socketpair(self):
+        """Returns the MCU end of a socketpair, for in-process harnesses"""
+        router_end, mcu_end = socket.socketpair()
+        self._socket = router_end
+        self.attach(router_end.fileno())
+        return mcu_end
+
+    # ---- router restarts, to exercise the bridge supervisor ----
+
+    def restart(self, downtime=0.5):
+        """Forgets every registration and connection, and ignores the link for downtime seconds"""
+        with self.state_lock:
+            self._close_all()
+            self.mcu_methods.clear()
+        self.down_until = time.monotonic() + downtime
+        print(f"[router] restarting, down for {downtime:.1f}s", file=sys.stderr)
+        if self.protocol >= PROTOCOL_CAPABLE:
+            threading.Timer(downtime, self.hello).start()
+
+    def hello(self):
+        """Tells the MCU the router (re)started, as a real router does once it is up"""
+        self.notify("$/hello")
+
+    # ---- msgpack-rpc plumbing ----
+
+    def _send(self, message):
+        data = packb(message)
+        if self.deframer:
+            data = encode_frame(data)
+        with self.tx_lock:
+            self.link.write(data)
+
+    def _on_bytes(self, data):
+        if time.monotonic() < self.down_until:
+            return
+        with self.rx_lock:
+            if self.deframer:
+                # bad frames are dropped whole: the decoder only sees complete messages
+                for payload in self.deframer.feed(data):
+                    self.unpacker.feed(payload)
+            else:
+                self.unpacker.feed(data)
+            self._drain()
+
+    def _drain(self):
+        while True:
+            try:
+                message = next(self.unpacker)
+            except StopIteration:
+                return
+            except FormatError:
+                self.unpacker.skip_byte()
+                continue
+            self.last_progress = time.monotonic()
+            self._dispatch(message)
+
+    def _resync_watchdog(self):
+        while True:
+            time.sleep(RESYNC_MS / 2000.0)
+            with self.rx_lock:
+                stalled = time.monotonic() - self.last_progress > RESYNC_MS / 1000.0
+                if self.unpacker.buffered() and stalled:
+                    self.stats.garbage += 1
+                    self.unpacker.skip_byte()
+                    self.last_progress = time.monotonic()
+                    self._drain()
+
+    def _dispatch(self, message):
+        if not isinstance(message, list) or not message or message[0] not in (REQUEST, RESPONSE, NOTIFY):
+            # boot banner or line noise
+            self.stats.garbage += 1
+            return
+        kind = message[0]
+        if kind == REQUEST and len(message) == 4:
+            _, msg_id, method, params = message
+            self._lane_for(method, params).submit(lambda: self._serve(msg_id, method, params))
+        elif kind == NOTIFY and len(message) == 3 and message[1] == "$/partial" and len(message[2]) == 3:
+            # kept in order with the final response: never goes through a lane
+            self._on_partial(*message[2])
+        elif kind == NOTIFY and len(message) == 3:
+            _, method, params = message
+            self._lane_for(method, params).submit(lambda: self._serve(None, method, params))
+        elif kind == RESPONSE and len(message) == 4:
+            _, msg_id, error, result = message
+            slot = self.pending.pop(msg_id, None)
+            if slot:
+                slot[1], slot[2] = error, result
+                if slot[3] and not error:
+                    slot[1], slot[2] = self._reassemble(slot[3], result)
+                slot[0].set()
+        else:
+            self.stats.garbage += 1
+
+    def _on_partial(self, msg_id, seq, items):
+        slot = self.pending.get(msg_id)
+        if slot:
+            slot[3].append((seq, items))
+
+    @staticmethod
+    def _reassemble(chunks, end):
+        """Result of a streamed response out of its chunks and BridgeStreamEnd [items, chunks, complete]"""
+        items, count, complete = end
+        if not complete:
+            return [GENERIC_ERR, "streamed response aborted by the MCU"], None
+        if [seq for seq, _ in chunks] != list(range(count)):
+            return [GENERIC_ERR, f"streamed response lost chunks: got {len(chunks)} of {count}"], None
+        out = [item for _, part in chunks for item in part]
+        if len(out) != items:
+            return [GENERIC_ERR, f"streamed response lost items: got {len(out)} of {items}"], None
+        if out and all(isinstance(item, (bytes, bytearray)) for item in out):
+            return None, b"".join(out)
+        return None, out
+
+    def _lane_for(self, method, params):
+        prefix = method.split("/", 1)[0]
+        key = "control"
+        if prefix in ("tcp", "udp") and params and isinstance(params[0], int):
+            key = f"{prefix}:{params[0]}"
+        elif prefix in ("mon", "hci"):
+            key = prefix
+        elif prefix == "conn":
+            # a poll may wait: keep it off the control lane
+            key = "poll"
+        elif method in self.app_methods:
+            key = f"app:{method}"
+        with self.lanes_lock:
+            lane = self.lanes.get(key)
+            if lane is None:
+                lane = self.lanes[key] = Lane(key)
+            return lane
+
+    def _serve(self, msg_id, method, params):
+        start = time.monotonic()
+        func = self.methods.get(method) or self.app_methods.get(method)
+        error, result = None, None
+        try:
+            if func is None:
+                raise RpcFault(FUNCTION_NOT_FOUND_ERR, f"method {method} not available")
+            result = func(*params) if isinstance(params, list) else func(params)
+        except RpcFault as fault:
+            error = [fault.code, fault.message]
+        except TypeError as exc:
+            error = [MALFORMED_CALL_ERR, str(exc)]
+        except Exception as exc:  # noqa: BLE001 - surfaced to the MCU as a generic error
+            error = [GENERIC_ERR, f"{type(exc).__name__}: {exc}"]
+
+        payload = 0
+        if method.endswith("/write") and len(params) >= 2:
+            payload = len(params[-1]) if not isinstance(params[-1], int) else 0
+        elif method in ("mon/write",) and params:
+            payload = len(params[0])
+        elif isinstance(result, (bytes, bytearray)):
+            payload = len(result)
+        self.stats.record(method, time.monotonic() - start, error is not None, payload)
+
+        if msg_id is not None:
+            self._send([RESPONSE, msg_id, error, result])
+
+    # ---- calls towards the MCU ----
+
+    def provide(self, name, func):
+        """Serves func to the MCU under name, like an App's Bridge.provide"""
+        self.app_methods[name] = func
+
+    def call(self, method, *params, timeout=5.0):
+        with self.state_lock:
+            msg_id = self.next_msg_id
+            self.next_msg_id = (self.next_msg_id + 1) & 0xFFFFFFFF
+        slot = [threading.Event(), None, None, []]       # done, error, result, streamed chunks
+        self.pending[msg_id] = slot
+        start = time.monotonic()
+        self._send([REQUEST, msg_id, method, list(params)])
+        if not slot[0].wait(timeout):
+            self.pending.pop(msg_id, None)
+            raise TimeoutError(f"{method} timed out")
+        self.call_latency.append(time.monotonic() - start)
+        if slot[1]:
+            raise RpcFault(*slot[1]) if isinstance(slot[1], list) and len(slot[1]) == 2 else RpcFault(GENERIC_ERR, str(slot[1]))
+        return slot[2]
+
+    def notify(self, method, *params):
+        self._send([NOTIFY, method, list(params)])
+
+    def wait_for_method(self, name, timeout=None):
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while name not in self.mcu_methods:
+            if deadline is not None and time.monotonic() > deadline:
+                return False
+            time.sleep(0.01)
+        return True
+
+    # ---- $/ methods ----
+
+    def reset(self):
+        with self.state_lock:
+            self._close_all()
+            self.mcu_methods.clear()
+        return True
+
+    def register(self, name):
+        with self.state_lock:
+            if name in self.mcu_methods:
+                return False
+            self.mcu_methods.add(name)
+        print(f"[router] MCU provides {name}", file=sys.stderr)
+        return True
+
+    def register_batch(self, names):
+        if not self.batching:
+            raise RpcFault(FUNCTION_NOT_FOUND_ERR, "method $/registerBatch not available")
+        return all([self.register(name) for name in names])
+
+    def get_version(self):
+        if self.protocol < PROTOCOL_VERSIONED:
+            raise RpcFault(FUNCTION_NOT_FOUND_ERR, "method $/version not available")
+        return self.version
+
+    def get_capabilities(self):
+        if self.protocol < PROTOCOL_CAPABLE:
+            raise RpcFault(FUNCTION_NOT_FOUND_ERR, "method $/capabilities not available")
+        # RouterCapabilities: protocol, version, bin_payloads, push_notifications, batching, max_frame
+        return [PROTOCOL_CAPABLE, self.version, self.bin_payloads, False, self.batching, self.max_frame]
+
+    # ---- tcp ----
+
+    def _new_id(self):
+        with self.state_lock:
+            new_id = self.next_id
+            self.next_id += 1
+            return new_id
+
+    def _tcp(self, conn_id):
+        sock = self.tcp.get(conn_id)
+        if sock is None:
+            raise RpcFault(GENERIC_ERR, f"unknown connection {conn_id}")
+        return sock
+
+    def _add_tcp(self, sock):
+        sock.setblocking(False)
+        conn_id = self._new_id()
+        self.tcp[conn_id] = sock
+        return conn_id
+
+    def tcp_connect(self, host, port):
+        return self._add_tcp(socket.create_connection((host, port), timeout=5))
+
+    def tcp_connect_ssl(self, host, port, ca_pem=""):
+        context = ssl.create_default_context(cadata=ca_pem or None)
+        raw = socket.create_connection((host, port), timeout=5)
+        return self._add_tcp(context.wrap_socket(raw, server_hostname=host))
+
+    def tcp_register_ca(self, pem):
+        ca_id = self._new_id()
+        self.cas[ca_id] = pem
+        return ca_id
+
+    def tcp_unregister_ca(self, ca_id):
+        return self.cas.pop(ca_id, None) is not None
+
+    def tcp_connect_ssl_ca(self, host, port, ca_id, options=0):
+        if ca_id not in self.cas:
+            raise RpcFault(GENERIC_ERR, f"unknown CA {ca_id}")
+        return self.tcp_connect_ssl(host, port, self.cas[ca_id])
+
+    def tcp_close(self, conn_id):
+        sock = self.tcp.pop(conn_id, None)
+        if sock:
+            sock.close()
+        return "closed"
+
+    def tcp_write(self, conn_id, data):
+        sock = self._tcp(conn_id)
+        payload = as_bytes(data)
+        sock.setblocking(True)
+        try:
+            sock.sendall(payload)
+        finally:
+            sock.setblocking(False)
+        return len(payload)
+
+    def tcp_read(self, conn_id, size, timeout_ms=0):
+        sock = self._tcp(conn_id)
+        if isinstance(sock, ssl.SSLSocket) and sock.pending():
+            return sock.recv(size)
+        ready, _, _ = select.select([sock], [], [], timeout_ms / 1000.0)
+        if not ready:
+            return b""
+        try:
+            data = sock.recv(size)
+        except (BlockingIOError, ssl.SSLWantReadError):
+            return b""
+        if not data:
+            raise RpcFault(GENERIC_ERR, "connection closed by peer")
+        return data
+
+    def tcp_listen(self, host, port):
+        server = socket.socket(socket.AF_INET, socket.SOCK_STREAM)
+        server.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        server.bind((host, port))
+        server.listen()
+        server.setblocking(False)
+        listener_id = self._new_id()
+        self.listeners[listener_id] = server
+        return listener_id
+
+    def tcp_accept(self, listener_id):
+        server = self.listeners.get(listener_id)
+        if server is None:
+            raise RpcFault(GENERIC_ERR, f"unknown listener {listener_id}")
+        ready, _, _ = select.select([server], [], [], 0.1)
+        if not ready:
+            raise RpcFault(GENERIC_ERR, "no pending connection")
+        conn, _ = server.accept()
+        return self._add_tcp(conn)
+
+    def tcp_close_listener(self, listener_id):
+        server = self.listeners.pop(listener_id, None)
+        if server:
+            server.close()
+        return "closed"
+
+    # ---- udp ----
+
+    def _udp(self, conn_id):
+        entry = self.udp.get(conn_id)
+        if entry is None:
+            raise RpcFault(GENERIC_ERR, f"unknown connection {conn_id}")
+        return entry
+
+    def udp_connect(self, host, port):
+        sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+        sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+        sock.bind((host, port))
+        conn_id = self._new_id()
+        self.udp[conn_id] = {"sock": sock, "target": None, "out": bytearray(), "packet": b""}
+        return conn_id
+
+    def udp_close(self, conn_id):
+        entry = self.udp.pop(conn_id, None)
+        if entry:
+            entry["sock"].close()
+        return "closed"
+
+    def udp_begin_packet(self, conn_id, host, port):
+        entry = self._udp(conn_id)
+        entry["target"] = (host, port)
+        entry["out"] = bytearray()
+        return True
+
+    def udp_write(self, conn_id, data):
+        payload = as_bytes(data)
+        self._udp(conn_id)["out"] += payload
+        return len(payload)
+
+    def udp_end_packet(self, conn_id):
+        entry = self._udp(conn_id)
+        if entry["target"] is None:
+            raise RpcFault(GENERIC_ERR, "no packet begun")
+        sent = entry["sock"].sendto(bytes(entry["out"]), entry["target"])
+        entry["out"] = bytearray()
+        return sent
+
+    def udp_await_packet(self, conn_id, timeout_ms=0):
+        entry = self._udp(conn_id)
+        ready, _, _ = select.select([entry["sock"]], [], [], timeout_ms / 1000.0)
+        if not ready:
+            raise RpcFault(GENERIC_ERR, "no packet")
+        data, (host, port) = entry["sock"].recvfrom(65535)
+        entry["packet"] = data
+        # BridgeUdpMeta: size, host, port
+        return [len(data), host, port]
+
+    def udp_read(self, conn_id, size, timeout_ms=0):
+        entry = self._udp(conn_id)
+        data, entry["packet"] = entry["packet"][:size], entry["packet"][size:]
+        return data
+
+    def udp_drop_packet(self, conn_id):
+        self._udp(conn_id)["packet"] = b""
+        return True
+
+    # ---- monitor ----
+
+    def mon_reset(self):
+        with self.state_lock:
+            self.monitor_in.clear()
+        return True
+
+    def mon_read(self, size):
+        with self.state_lock:
+            data = bytes(self.monitor_in[:size])
+            del self.monitor_in[:size]
+        return data
+
+    def mon_write(self, data):
+        payload = as_bytes(data)
+        self.monitor_out += payload
+        if self.echo_monitor:
+            sys.stdout.write(payload.decode("utf-8", errors="replace"))
+            sys.stdout.flush()
+        return len(payload)
+
+    def monitor_input(self, data):
+        with self.state_lock:
+            self.monitor_in += data
+
+    # ---- hci ----
+
+    def hci_open(self, device):
+        self.hci.open = True
+        return True
+
+    def hci_close(self):
+        self.hci.open = False
+        return True
+
+    def hci_send(self, packet):
+        if not self.hci.open:
+            raise RpcFault(GENERIC_ERR, "HCI device not open")
+        return self.hci.send(as_bytes(packet))
+
+    def hci_recv(self, max_size):
+        return self.hci.recv(max_size)
+
+    # ---- splice ----
+
+    def splice_start(self, src_id, dst_id, options=0):
+        splice = Splice(SpliceEndpoint(self, src_id), SpliceEndpoint(self, dst_id), options)
+        splice_id = self._new_id()
+        self.splices[splice_id] = splice
+        return splice_id
+
+    def _splice(self, splice_id):
+        splice = self.splices.get(splice_id)
+        if splice is None:
+            raise RpcFault(GENERIC_ERR, f"unknown splice {splice_id}")
+        return splice
+
+    def splice_stats(self, splice_id):
+        return self._splice(splice_id).stats()
+
+    def splice_stop(self, splice_id):
+        stats = self._splice(splice_id).stop()
+        del self.splices[splice_id]
+        return stats
+
+    # ---- poll ----
+
+    def _poll_socket(self, sock):
+        readable, writable, _ = select.select([sock], [sock], [], 0)
+        events, available = 0, 0
+        if writable:
+            events |= POLL_WRITE
+        if isinstance(sock, ssl.SSLSocket) and sock.pending():
+            return events | POLL_READ, sock.pending()
+        if readable:
+            try:
+                peeked = sock.recv(65535, socket.MSG_PEEK)
+            except (BlockingIOError, ssl.SSLWantReadError):
+                return events, 0
+            except OSError:
+                return events | POLL_CLOSED, 0
+            if not peeked:
+                return events | POLL_CLOSED, 0
+            events |= POLL_READ
+            available = len(peeked)
+        return events, available
+
+    def _poll_one(self, conn_id):
+        """[events, available] of one connection, as in BridgePollStatus"""
+        if conn_id == SPLICE_MONITOR_ID:
+            with self.state_lock:
+                pending = len(self.monitor_in)
+            return [POLL_WRITE | (POLL_READ if pending else 0), pending]
+        if conn_id in self.tcp:
+            return list(self._poll_socket(self.tcp[conn_id]))
+        if conn_id in self.udp:
+            entry = self.udp[conn_id]
+            if entry["packet"]:
+                return [POLL_READ | POLL_WRITE, len(entry["packet"])]
+            readable, _, _ = select.select([entry["sock"]], [], [], 0)
+            if not readable:
+                return [POLL_WRITE, 0]
+            peeked = entry["sock"].recv(65535, socket.MSG_PEEK)
+            return [POLL_READ | POLL_WRITE, len(peeked)]
+        if conn_id in self.listeners:
+            readable, _, _ = select.select([self.listeners[conn_id]], [], [], 0)
+            return [POLL_READ if readable else 0, 0]
+        return [POLL_INVALID | POLL_CLOSED, 0]
+
+    def conn_poll(self, entries, timeout_ms=0):
+        """entries: [[conn_id, interests], ...]. Answers once one of them has an event it
+        asked for (closed and unknown ids always count), or when timeout_ms is over"""
+        deadline = time.monotonic() + timeout_ms / 1000.0
+        while True:
+            answer, ready = [], False
+            for conn_id, interests in entries:
+                status = self._poll_one(conn_id)
+                if status[0] & (interests | POLL_CLOSED | POLL_INVALID):
+                    ready = True
+                answer.append(status)
+            if ready or time.monotonic() >= deadline:
+                return answer
+            time.sleep(POLL_STEP_S)
+
+    def _close_all(self):
+        for splice in self.splices.values():
+            splice.stop()
+        self.splices.clear()
+        for sock in list(self.tcp.values()) + list(self.listeners.values()):
+            sock.close()
+        for entry in self.udp.values():
+            entry["sock"].close()
+        self.tcp.clear()
+        self.listeners.clear()
+        self.udp.clear()
+        self.cas.clear()
+
+
+def run_bench(router, method, args, count, concurrency):
+    print(f"[bench] waiting for the MCU to provide {method}", file=sys.stderr)
+    router.wait_for_method(method)
+    latencies = []
+    failures = 0
+    lock = threading.Lock()
+    todo = iter(range(count))
+
+    def worker():
+        nonlocal failures
+        while True:
+            with lock:
+                if next(todo, None) is None:
+                    return
+            start = time.monotonic()
+            try:
+                router.call(method, *args)
+                ok = True
+            except (TimeoutError, RpcFault):
+                ok = False
+            with lock:
+                if ok:
+                    latencies.append(time.monotonic() - start)
+                else:
+                    failures += 1
+
+    start = time.monotonic()
+    threads = [threading.Thread(target=worker) for _ in range(concurrency)]
+    for t in threads:
+        t.start()
+    for t in threads:
+        t.join()
+    elapsed = time.monotonic() - start
+
+    latencies.sort()
+    print(f"[bench] {len(latencies)} ok, {failures} failed in {elapsed:.2f}s, {len(latencies) / elapsed:.1f} calls/s")
+    for p in (50, 90, 99, 99.9):
+        print(f"[bench] p{p}: {percentile(latencies, p) * 1e3:.2f} ms")
+    print(f"[bench] max: {(latencies[-1] if latencies else 0) * 1e3:.2f} ms")
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stand-in router with an emulated UART link")
+    where = parser.add_mutually_exclusive_group(required=True)
+    where.add_argument("--pty", action="store_true", help="create a pty and print the MCU side path")
+    where.add_argument("--device", help="serial device connected to the MCU")
+    parser.add_argument("--device-baud", type=int, default=115200)
+
+    link = parser.add_argument_group("link emulation")
+    link.add_argument("--baud", type=int, default=0, help="emulated wire speed, 0 for none")
+    link.add_argument("--latency-us", type=float, default=0.0)
+    link.add_argument("--jitter-us", type=float, default=0.0)
+    link.add_argument("--loss", type=float, default=0.0, help="byte drop probability")
+    link.add_argument("--corruption", type=float, default=0.0, help="bit flip probability per byte")
+    link.add_argument("--seed", type=int, default=0)
+
+    router_opts = parser.add_argument_group("router")
+    router_opts.add_argument("--protocol", choices=("legacy", "versioned", "capable"), default="capable")
+    router_opts.add_argument("--max-frame", type=int, default=256)
+    router_opts.add_argument("--no-bin", action="store_true", help="do not advertise bin payloads")
+    router_opts.add_argument("--no-batching", action="store_true", help="do not offer $/registerBatch")
+    router_opts.add_argument("--restart-every", type=float, default=0.0, help="simulate a router restart every N seconds")
+    router_opts.add_argument("--restart-downtime", type=float, default=0.5)
+    router_opts.add_argument("--framed", action="store_true", help="speak the BRIDGE_FRAMED_LINK framing")
+    router_opts.add_argument("--monitor-stdin", action="store_true", help="feed stdin to mon/read")
+
+    bench = parser.add_argument_group("benchmark")
+    bench.add_argument("--bench", metavar="METHOD", help="call an MCU provided method and report latency")
+    bench.add_argument("--bench-args", default="[]", help="JSON list of arguments")
+    bench.add_argument("--bench-count", type=int, default=1000)
+    bench.add_argument("--bench-concurrency", type=int, default=1)
+
+    args = parser.parse_args()
+
+    config = LinkConfig(baud=args.baud, latency_us=args.latency_us, jitter_us=args.jitter_us,
+                        loss=args.loss, corruption=args.corruption, seed=args.seed)
+    protocol = {"legacy": PROTOCOL_LEGACY, "versioned": PROTOCOL_VERSIONED, "capable": PROTOCOL_CAPABLE}[args.protocol]
+    router = Router(config, protocol=protocol, max_frame=args.max_frame,
+                    bin_payloads=not args.no_bin, batching=not args.no_batching, framed=args.framed)
+
+    if args.pty:
+        print(f"MCU side: {router.open_pty()}", file=sys.stderr)
+    else:
+        router.open_device(args.device, args.device_baud)
+
+    if args.monitor_stdin:
+        def feed_stdin():
+            for line in sys.stdin:
+                router.monitor_input(line.encode())
+        threading.Thread(target=feed_stdin, daemon=True).start()
+
+    start = time.monotonic()
+    try:
+        if args.bench:
+            run_bench(router, args.bench, json.loads(args.bench_args), args.bench_count, args.bench_concurrency)
+        else:
+            while True:
+                if args.restart_every > 0:
+                    time.sleep(args.restart_every)
+                    router.restart(args.restart_downtime)
+                else:
+                    time.sleep(1)
+    except KeyboardInterrupt:
+        pass
+    finally:
+        router.stats.report(elapsed=time.monotonic() - start)
+        if router.deframer:
+            print(f"framing: {router.deframer.dropped} bad frames dropped, {router.deframer.skipped} bytes skipped", file=sys.stderr)
+        for direction, s in router.link.stats().items():
+            print(f"link {direction}: {s.bytes} bytes, {s.lost} lost, {s.corrupted} corrupted", file=sys.stderr)
+
+
+if __name__ == "__main__":
+    main()
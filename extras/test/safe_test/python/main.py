@@ -0,0 +1,36 @@
+"""
+Safe Provider Test, router side
+
+Calls the methods exposed by safe_test.ino and checks in which thread the MCU served
+them: safe/in_loop must always answer True (loop() thread, through update_safe()),
+update/in_loop must always answer False (bridge update thread).
+"""
+
+import threading
+import time
+from arduino.app_utils import *
+
+CALLS = 100
+
+
+def check(method, expected):
+    wrong = 0
+    for _ in range(CALLS):
+        if Bridge.call(method) != expected:
+            wrong += 1
+    status = "✓ PASS" if wrong == 0 else "✗ FAIL"
+    print(f"{status}: {method} answered {expected} {CALLS - wrong} of {CALLS} times")
+    return wrong == 0
+
+
+def run_tests():
+    # let the sketch provide its methods
+    time.sleep(2)
+    passed = check("safe/in_loop", True)
+    passed = check("update/in_loop", False) and passed
+    print("All tests passed" if passed else "Some tests failed")
+
+
+if __name__ == "__main__":
+    threading.Thread(target=run_tests, daemon=True).start()
+    App.run()
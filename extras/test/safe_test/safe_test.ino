@@ -0,0 +1,72 @@
+/*
+ * Safe Provider Test
+ *
+ * This sketch checks that methods exposed with provide_safe run in the loop()
+ * thread, through update_safe(), while methods exposed with provide run in the
+ * bridge update thread.
+ *
+ * Server Requirements:
+ * - Run python/main.py on the router side: it calls both methods and reports
+ *   which thread served them
+ */
+
+#include <Arduino.h>
+#include "Arduino_RouterBridge.h"
+
+// setup() and loop() share the main thread
+k_tid_t loop_thread;
+
+unsigned long safeCalls = 0;
+unsigned long safeOutsideLoop = 0;
+unsigned long updateCalls = 0;
+unsigned long updateInsideLoop = 0;
+
+// Must only ever run in the loop() thread
+bool safe_in_loop() {
+    safeCalls++;
+    const bool in_loop = k_current_get() == loop_thread;
+    if (!in_loop) safeOutsideLoop++;
+    return in_loop;
+}
+
+// Must never run in the loop() thread
+bool update_in_loop() {
+    updateCalls++;
+    const bool in_loop = k_current_get() == loop_thread;
+    if (in_loop) updateInsideLoop++;
+    return in_loop;
+}
+
+void setup() {
+    loop_thread = k_current_get();
+
+    Bridge.begin();
+    Monitor.begin();
+
+    if (!Bridge.provide_safe("safe/in_loop", safe_in_loop)) {
+        Monitor.println("✗ FAIL: provide_safe(\"safe/in_loop\")");
+    }
+    if (!Bridge.provide("update/in_loop", update_in_loop)) {
+        Monitor.println("✗ FAIL: provide(\"update/in_loop\")");
+    }
+
+    Monitor.println("Safe provider test ready");
+}
+
+void loop() {
+    static unsigned long lastReport = 0;
+    if (millis() - lastReport < 5000) return;
+    lastReport = millis();
+
+    Monitor.print(safeOutsideLoop == 0 ? "✓ PASS" : "✗ FAIL");
+    Monitor.print(": safe calls outside loop() ");
+    Monitor.print(safeOutsideLoop);
+    Monitor.print(" of ");
+    Monitor.println(safeCalls);
+
+    Monitor.print(updateInsideLoop == 0 ? "✓ PASS" : "✗ FAIL");
+    Monitor.print(": update calls inside loop() ");
+    Monitor.print(updateInsideLoop);
+    Monitor.print(" of ");
+    Monitor.println(updateCalls);
+}
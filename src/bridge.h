@@ -16,23 +16,680 @@
 
 #define RESET_METHOD "$/reset"
 #define BIND_METHOD "$/register"
+#define BIND_BATCH_METHOD "$/registerBatch"
 #define GET_VERSION_METHOD "$/version"
+#define GET_CAPABILITIES_METHOD "$/capabilities"
+// Notified by a router that just started: a started bridge takes it as a restart
+#define HELLO_METHOD "$/hello"
+#define TCP_REGISTER_CA_METHOD      "tcp/registerCA"
+#define TCP_UNREGISTER_CA_METHOD    "tcp/unregisterCA"
+
+// Tag of the methods served in the main loop
+#define SAFE_TAG "__safe__"
+
+// provide_safe requests decoded by the update thread and waiting for the main loop, at
+// most 32. Their buffers are allocated by the first provide_safe. When all are taken, the
+// update thread leaves the next request in the decoder until the loop catches up
+#ifndef BRIDGE_SAFE_QUEUE_SIZE
+#define BRIDGE_SAFE_QUEUE_SIZE      4
+#endif
+
+// Router protocol levels, as cached by BridgeClass::begin()
+#define ROUTER_PROTOCOL_LEGACY      0   // no $/version
+#define ROUTER_PROTOCOL_VERSIONED   1   // $/version, no $/capabilities
+#define ROUTER_PROTOCOL_CAPABLE     2   // $/capabilities
 
 //#define BRIDGE_ERROR "$/bridgeLog"
 
+// Define BRIDGE_STATIC_ALLOCATION to reserve the transport, RPC client and server and
+// the thread stacks inside the BridgeClass object: begin() then never touches the heap
+//#define BRIDGE_STATIC_ALLOCATION
+
+#ifndef UPDATE_THREAD_STACK_SIZE
 #define UPDATE_THREAD_STACK_SIZE    500
+#endif
+#ifndef UPDATE_THREAD_PRIORITY
 #define UPDATE_THREAD_PRIORITY      5
+#endif
+
+// Sends the messages queued by call(), notify() and notify_from_isr()
+#ifndef WRITER_THREAD_STACK_SIZE
+#define WRITER_THREAD_STACK_SIZE    512
+#endif
+#ifndef WRITER_THREAD_PRIORITY
+#define WRITER_THREAD_PRIORITY      4
+#endif
+
+// Reconnects the bridge and checks that the router is still there. It mostly sleeps, and
+// runs above the update and writer threads so that they can never keep it from reconnecting
+#ifndef SUPERVISOR_THREAD_STACK_SIZE
+#define SUPERVISOR_THREAD_STACK_SIZE    1024
+#endif
+#ifndef SUPERVISOR_THREAD_PRIORITY
+#define SUPERVISOR_THREAD_PRIORITY      3
+#endif
+
+// Each connection attempt ($/reset) waits this long for the router
+#ifndef BRIDGE_CONNECT_TIMEOUT_MS
+#define BRIDGE_CONNECT_TIMEOUT_MS       1000
+#endif
+
+#ifndef BRIDGE_RECONNECT_INTERVAL_MS
+#define BRIDGE_RECONNECT_INTERVAL_MS    100
+#endif
+
+// Restarts are told by the router $/hello. The heartbeat is the fallback for routers that
+// never send it or died: a link silent for this long, or that dropped a frame, gets a
+// $/version, and without an answer the bridge connects again and replays every provided method
+#ifndef BRIDGE_HEARTBEAT_INTERVAL_MS
+#define BRIDGE_HEARTBEAT_INTERVAL_MS    3000
+#endif
+
+#ifndef BRIDGE_HEARTBEAT_TIMEOUT_MS
+#define BRIDGE_HEARTBEAT_TIMEOUT_MS     500
+#endif
+
+// Without RX events the update thread checks the UART buffer at this period. Each check that
+// finds nothing doubles it, up to BRIDGE_IDLE_POLL_MAX_MS. Raising that one trades latency of
+// the first request after an idle spell for fewer wakeups
+#ifndef BRIDGE_IDLE_POLL_MS
+#define BRIDGE_IDLE_POLL_MS         1
+#endif
+
+#ifndef BRIDGE_IDLE_POLL_MAX_MS
+#define BRIDGE_IDLE_POLL_MAX_MS     BRIDGE_IDLE_POLL_MS
+#endif
 
 #define DEFAULT_SERIAL_BAUD         115200
 
+// Bulk payloads (tcp/udp writes) are split in frames of at most this many bytes,
+// so that higher priority traffic can be interleaved between them
+#ifndef BRIDGE_MAX_FRAME_PAYLOAD
+#define BRIDGE_MAX_FRAME_PAYLOAD    256
+#endif
+
+// Number of bulk frames a stream writer keeps in flight before waiting for acknowledgments
+#ifndef BRIDGE_STREAM_WINDOW
+#define BRIDGE_STREAM_WINDOW        4
+#endif
+
+// Deadline applied to calls that do not set their own, 0 waits forever
+#ifndef DEFAULT_RPC_TIMEOUT_MS
+#define DEFAULT_RPC_TIMEOUT_MS      0
+#endif
+
+// Abandoned (timed out or cancelled) calls whose late response is still expected
+#ifndef BRIDGE_MAX_ORPHANS
+#define BRIDGE_MAX_ORPHANS          32
+#endif
+
+// Calls made with BridgeClass::call_async that can wait for a response at the same time
+#ifndef BRIDGE_MAX_ASYNC_CALLS
+#define BRIDGE_MAX_ASYNC_CALLS      8
+#endif
+
+// Largest call_async callback, captures included. Bigger ones do not compile
+#ifndef BRIDGE_ASYNC_CALLBACK_SIZE
+#define BRIDGE_ASYNC_CALLBACK_SIZE  16
+#endif
+
+// Payloads sent from the caller's memory are handed to the transport in chunks of this size
+#ifndef BRIDGE_VIEW_CHUNK
+#define BRIDGE_VIEW_CHUNK           64
+#endif
+
+// Chunks of a streamed response are sent once they hold this many bytes, see provide_stream
+#ifndef BRIDGE_STREAM_CHUNK
+#define BRIDGE_STREAM_CHUNK         256
+#endif
+
+// Carries one chunk of a streamed response: [msg_id, seq, [items...]]
+#define PARTIAL_METHOD "$/partial"
+
+// Msg ids of the calls packed by the bridge itself, apart from the RPCClient ones
+#define BRIDGE_VIEW_MSG_ID_FLAG     0x80000000u
+
+// Extra links a bridge can spread bulk payloads over, see BridgeClass::bond
+#ifndef BRIDGE_MAX_BONDED_LINKS
+#define BRIDGE_MAX_BONDED_LINKS     3
+#endif
+
+// Error codes raised on the MCU side, next to the RPClite ones
+#define TIMEOUT_ERR                 0xFB
+#define CANCELLED_ERR               0xFA
+#define LINK_ERR                    0xF9    // a frame was dropped by BRIDGE_FRAMED_LINK
+
 #include <zephyr/kernel.h>
 #include <zephyr/sys/atomic.h>
 #include <Arduino_RPClite.h>
 
+#include <new>
+#include <cstddef>
 #include <utility>
+#include <type_traits>
+
+#include "rpc_cache.h"
+#include "providers.h"
+#include "splice.h"
+#include "poll_set.h"
+#include "tx_queue.h"
+#include "telemetry.h"
+#include "framed_link.h"
+
 
+// C++20 builds get awaitable calls, see bridge_coro.h
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+#define BRIDGE_HAS_COROUTINES
+template<typename RType> class RpcAwaitable;
+#endif
 
 void updateEntryPoint(void *, void *, void *);
+void supervisorEntryPoint(void *, void *, void *);
+void writerEntryPoint(void *, void *, void *);
+
+// Lightweight binary view to avoid dynamic allocation during serialization
+struct BinaryView {
+    const uint8_t *data;
+    size_t size;
+
+    BinaryView(const uint8_t *d, size_t s) : data(d), size(s) {
+
+    }
+
+    // MsgPack serialization support
+    void to_msgpack(MsgPack::Packer &packer) const {
+        packer.pack(data, size);
+    }
+};
+
+// Same as BinaryView, but packed as an array of uint8 for methods expecting a byte array
+struct ArrayView {
+    const uint8_t *data;
+    size_t size;
+
+    ArrayView(const uint8_t *d, size_t s) : data(d), size(s) {
+
+    }
+
+    void to_msgpack(MsgPack::Packer &packer) const {
+        packer.packArraySize(size);
+        for (size_t i = 0; i < size; ++i) {
+            packer.pack(data[i]);
+        }
+    }
+};
+
+// CA bundle stored on the router by BridgeClass::registerCA(). The id only lives as long as
+// the router session, so the bundle is registered again after a restart
+struct BridgeCAHandle {
+    uint32_t id = 0;
+    uint32_t session = 0;           // router session the id belongs to
+    const char* pem = nullptr;      // kept for registering again, must stay valid
+    bool valid = false;             // registered and not unregistered by the sketch
+};
+
+// Router features, fetched once by begin() with a single $/capabilities call
+struct RouterCapabilities {
+    uint32_t protocol;
+    MsgPack::str_t version;
+    bool bin_payloads;          // byte payloads may be sent as msgpack bin
+    bool push_notifications;    // the router can notify the MCU instead of being polled
+    bool batching;              // several operations can be sent in one call
+    uint32_t max_frame;         // largest payload the router accepts in one call, 0 if unbounded
+
+    RouterCapabilities() {
+        protocol = ROUTER_PROTOCOL_LEGACY;
+        version = "";
+        bin_payloads = false;
+        push_notifications = false;
+        batching = false;
+        max_frame = 0;
+    }
+
+    MSGPACK_DEFINE(protocol, version, bin_payloads, push_notifications, batching, max_frame); // -> [protocol, version, bin, push, batching, max_frame]
+};
+
+// Write side arbiter: a sender only gets the link when no higher priority sender is waiting.
+// A sender kept out by a higher class sleeps until the link is released: it never takes the
+// CPU from the holder, or from the sender it gives way to, whatever their thread priorities
+class BridgeWriteLock {
+
+    struct k_mutex mutex{};
+    atomic_t waiting[RPC_PRIORITY_COUNT] = {};
+    struct k_sem released[RPC_PRIORITY_COUNT]{};    // wakes the senders of a class kept out
+
+    bool higher_waiting(const RpcPriority prio) {
+        for (uint8_t p = 0; p < prio; ++p) {
+            if (atomic_get(&waiting[p]) > 0) return true;
+        }
+        return false;
+    }
+
+    // Has every class with a sender waiting look again
+    void wake_waiting() {
+        for (uint8_t p = 0; p < RPC_PRIORITY_COUNT; ++p) {
+            if (atomic_get(&waiting[p]) > 0) k_sem_give(&released[p]);
+        }
+    }
+
+public:
+
+    void init() {
+        k_mutex_init(&mutex);
+        for (uint8_t p = 0; p < RPC_PRIORITY_COUNT; ++p) {
+            k_sem_init(&released[p], 0, 1);
+        }
+    }
+
+    // deadline is an absolute k_uptime_get() value, 0 waits forever
+    bool lock(const RpcPriority prio, const int64_t deadline=0) {
+        bool locked = false;
+        atomic_inc(&waiting[prio]);
+        while (true) {
+            if (higher_waiting(prio)) {
+                // the 10 ms bound only matters if two senders of this class wait at once
+                k_sem_take(&released[prio], K_MSEC(10));
+            } else if (k_mutex_lock(&mutex, K_MSEC(10)) == 0) {
+                // a higher priority sender may have shown up while we were waiting
+                if (!higher_waiting(prio)) {
+                    locked = true;
+                    break;
+                }
+                k_mutex_unlock(&mutex);
+            }
+            if (deadline > 0 && k_uptime_get() >= deadline) break;
+        }
+        atomic_dec(&waiting[prio]);
+        // lower classes kept out by this sender may go now
+        if (!locked) wake_waiting();
+        return locked;
+    }
+
+    void unlock() {
+        k_mutex_unlock(&mutex);
+        wake_waiting();
+    }
+};
+
+// Consumes the late responses of abandoned calls, so they neither stall the decoder
+// nor stay in its buffer. Must be used holding the channel read mutex.
+// The decoder only hands out a response to the caller naming its id: one whose id was
+// forgotten would sit at its head and block every later response. So an id stays here, with
+// no time limit, until its response is consumed
+class RpcOrphans {
+
+    uint32_t ids[BRIDGE_MAX_ORPHANS]{};
+    size_t count = 0;
+    atomic_t overflows = ATOMIC_INIT(0);    // calls that found no room
+
+    void remove(size_t index) {
+        for (size_t i = index + 1; i < count; ++i) {
+            ids[i - 1] = ids[i];
+        }
+        count--;
+    }
+
+public:
+
+    // False when full: an evicted id would leave its response unclaimed, blocking every
+    // other one behind it. The caller then discards the response itself
+    bool add(uint32_t msg_id) {
+        if (count == BRIDGE_MAX_ORPHANS) {
+            atomic_inc(&overflows);
+            return false;
+        }
+        ids[count++] = msg_id;
+        return true;
+    }
+
+    bool full() const {
+        return count == BRIDGE_MAX_ORPHANS;
+    }
+
+    uint32_t overflowed() const {
+        return atomic_get(&overflows);
+    }
+
+    // A restarted router will never answer any of them
+    void clear() {
+        count = 0;
+    }
+
+    void drain(RPCClient& client) {
+        size_t i = 0;
+        while (i < count) {
+            MsgPack::object::nil_t nil;
+            RpcError err;
+            if (client.get_response(ids[i], nil, err)) {
+                remove(i);
+            } else {
+                ++i;
+            }
+        }
+    }
+
+};
+
+// Result type of a call_async callback, taken from its first parameter:
+// void(RType result, const RpcError& error)
+template<typename F>
+struct AsyncResultOf : AsyncResultOf<decltype(&F::operator())> {};
+
+template<typename R, typename T, typename E>
+struct AsyncResultOf<R(*)(T, E)> { using type = typename std::decay<T>::type; };
+
+template<typename R, typename C, typename T, typename E>
+struct AsyncResultOf<R(C::*)(T, E)> { using type = typename std::decay<T>::type; };
+
+template<typename R, typename C, typename T, typename E>
+struct AsyncResultOf<R(C::*)(T, E) const> { using type = typename std::decay<T>::type; };
+
+// Pending call_async completions. A caller claims a slot, sends and arms it; the update
+// thread decodes the response and runs the callback. No thread blocks in between
+class RpcAsyncCalls {
+
+    // draining: failed already, its response is discarded here for want of an orphan entry
+    enum : atomic_val_t { SLOT_FREE, SLOT_CLAIMED, SLOT_PENDING, SLOT_DRAINING };
+
+    struct Slot {
+        atomic_t state = ATOMIC_INIT(SLOT_FREE);
+        uint32_t msg_id = 0;
+        int64_t deadline = 0;
+        atomic_val_t link_errors = 0;   // channel link error count when sent
+        atomic_t cancelled = ATOMIC_INIT(0);    // msg_id of the call to cancel
+        // Called holding the read mutex, which it releases before running the callback
+        bool (*complete)(Slot&, RPCClient&, struct k_mutex&) = nullptr;
+        void (*fail)(Slot&, const RpcError&) = nullptr;
+        alignas(std::max_align_t) uint8_t callback[BRIDGE_ASYNC_CALLBACK_SIZE];
+    };
+
+    Slot slots[BRIDGE_MAX_ASYNC_CALLS];
+    atomic_t armed = ATOMIC_INIT(0);
+
+    template<typename RType, typename Callback>
+    static void run(Slot& slot, const RType& result, const RpcError& error) {
+        Callback* callback = reinterpret_cast<Callback*>(slot.callback);
+        (*callback)(result, error);
+        callback->~Callback();
+    }
+
+    template<typename RType, typename Callback>
+    static bool complete(Slot& slot, RPCClient& client, struct k_mutex& read_mutex) {
+        RType result{};
+        RpcError error;
+        const bool got = client.get_response(slot.msg_id, result, error);
+        k_mutex_unlock(&read_mutex);
+        if (got) run<RType, Callback>(slot, result, error);
+        return got;
+    }
+
+    template<typename RType, typename Callback>
+    static void fail(Slot& slot, const RpcError& error) {
+        run<RType, Callback>(slot, RType{}, error);
+    }
+
+    void done(Slot& slot) {
+        atomic_dec(&armed);
+        atomic_set(&slot.state, SLOT_FREE);
+    }
+
+public:
+
+    typedef Slot* Handle;
+
+    // Names one call: a slot is reused once its call completed, under a new msg_id
+    struct Ticket {
+        Handle slot = nullptr;
+        uint32_t msg_id = 0;
+    };
+
+    bool pending() const {
+        return atomic_get(&armed) > 0;
+    }
+
+    // nullptr when every slot is waiting for a response
+    Handle claim() {
+        for (Slot& slot : slots) {
+            if (atomic_cas(&slot.state, SLOT_FREE, SLOT_CLAIMED)) return &slot;
+        }
+        return nullptr;
+    }
+
+    // Gives back a claimed slot whose call could not be sent
+    void release(Handle slot) {
+        atomic_set(&slot->state, SLOT_FREE);
+    }
+
+    template<typename RType, typename F>
+    void arm(Handle slot, uint32_t msg_id, int64_t deadline, atomic_val_t link_errors, F&& callback) {
+        using Callback = typename std::decay<F>::type;
+        static_assert(sizeof(Callback) <= BRIDGE_ASYNC_CALLBACK_SIZE, "call_async callback too big, raise BRIDGE_ASYNC_CALLBACK_SIZE");
+        static_assert(alignof(Callback) <= alignof(std::max_align_t), "call_async callback over-aligned");
+
+        new (slot->callback) Callback(std::forward<F>(callback));
+        slot->msg_id = msg_id;
+        slot->deadline = deadline;
+        slot->link_errors = link_errors;
+        atomic_set(&slot->cancelled, 0);
+        slot->complete = &complete<RType, Callback>;
+        slot->fail = &fail<RType, Callback>;
+        atomic_inc(&armed);
+        atomic_set(&slot->state, SLOT_PENDING);
+    }
+
+    // Has the next poll fail the call with CANCELLED_ERR. No effect once it completed
+    void cancel(const Ticket& ticket) {
+        atomic_set(&ticket.slot->cancelled, static_cast<atomic_val_t>(ticket.msg_id));
+    }
+
+    // Runs the callbacks of the calls that got their response, expired, or may have lost it
+    // to a dropped frame (link_errors moved since they were sent). Returns true if any did
+    bool poll(RPCClient& client, struct k_mutex& read_mutex, RpcOrphans& orphans, atomic_val_t link_errors) {
+        if (!pending()) return false;
+
+        bool any = false;
+        for (Slot& slot : slots) {
+            const atomic_val_t state = atomic_get(&slot.state);
+            if (state != SLOT_PENDING && state != SLOT_DRAINING) continue;
+            if (k_mutex_lock(&read_mutex, K_MSEC(10)) != 0) break;
+
+            orphans.drain(client);
+            if (state == SLOT_DRAINING) {
+                MsgPack::object::nil_t nil;
+                RpcError err;
+                if (client.get_response(slot.msg_id, nil, err) || (!orphans.full() && orphans.add(slot.msg_id))) {
+                    done(slot);
+                    any = true;
+                }
+                k_mutex_unlock(&read_mutex);
+                continue;
+            }
+            if (slot.complete(slot, client, read_mutex)) {
+                done(slot);
+                any = true;
+                continue;
+            }
+
+            const bool cancelled = static_cast<uint32_t>(atomic_get(&slot.cancelled)) == slot.msg_id;
+            const bool lost = slot.link_errors != link_errors;
+            if (cancelled || lost || (slot.deadline > 0 && k_uptime_get() >= slot.deadline)) {
+                // the response may still come: leave its msg_id to be discarded
+                k_mutex_lock(&read_mutex, K_FOREVER);
+                const bool orphaned = orphans.add(slot.msg_id);
+                k_mutex_unlock(&read_mutex);
+                if (cancelled) {
+                    slot.fail(slot, RpcError(CANCELLED_ERR, "This call was cancelled"));
+                } else if (lost) {
+                    slot.fail(slot, RpcError(LINK_ERR, "A frame was dropped on the link"));
+                } else {
+                    slot.fail(slot, RpcError(TIMEOUT_ERR, "Timed out waiting for the response"));
+                }
+                if (orphaned) {
+                    done(slot);
+                } else {
+                    atomic_set(&slot.state, SLOT_DRAINING);
+                }
+                any = true;
+            }
+        }
+        return any;
+    }
+
+};
+
+// What an in-flight call needs from its bridge
+struct RpcChannel {
+    RPCClient* client = nullptr;
+    ITransport* transport = nullptr;
+    BridgeFramedTransport* framed = nullptr;    // transport, when BRIDGE_FRAMED_LINK is defined
+    atomic_t link_errors = ATOMIC_INIT(0);      // frames dropped so far
+    atomic_t local_msg_id = ATOMIC_INIT(0);
+    struct k_mutex read_mutex{};
+    BridgeWriteLock write_lock{};
+    BridgeTxQueue tx{};
+    RpcOrphans orphans{};
+    RpcAsyncCalls async{};
+    atomic_t default_timeout = ATOMIC_INIT(DEFAULT_RPC_TIMEOUT_MS);
+    struct k_sem rx_sem{};      // wakes the update thread
+    atomic_t last_rx = ATOMIC_INIT(0);  // uptime in ms of the last message from the router
+
+    void init() {
+        k_mutex_init(&read_mutex);
+        write_lock.init();
+        tx.init();
+        k_sem_init(&rx_sem, 0, 1);
+    }
+
+    // Response pollers decode whatever is on the link, requests included:
+    // let the update thread look at them
+    void wake_update() {
+        k_sem_give(&rx_sem);
+    }
+
+    void heard() {
+        atomic_set(&last_rx, static_cast<atomic_val_t>(k_uptime_get_32()));
+    }
+
+    uint32_t silent_ms() const {
+        return k_uptime_get_32() - static_cast<uint32_t>(atomic_get(&last_rx));
+    }
+
+    // Msg id of a call packed by the bridge rather than by the RPCClient
+    uint32_t next_msg_id() {
+        return (static_cast<uint32_t>(atomic_inc(&local_msg_id)) & ~BRIDGE_VIEW_MSG_ID_FLAG) | BRIDGE_VIEW_MSG_ID_FLAG;
+    }
+
+    // Takes the write lock for a direct write once the frames queued at priority so far are
+    // on the link, so nothing overtakes them. deadline is an absolute k_uptime_get() value,
+    // 0 waits forever
+    bool lock_in_order(const RpcPriority priority, const int64_t deadline=0) {
+        const atomic_val_t mark = tx.mark(priority);
+        while (!tx.sent_up_to(priority, mark)) {
+            if (deadline > 0 && k_uptime_get() >= deadline) return false;
+            k_msleep(1);
+        }
+        return write_lock.lock(priority, deadline);
+    }
+
+    // Copies an encoded message in a frame for the writer thread and returns: the sender
+    // never waits for the UART. Only when every frame is taken does it wait, until deadline.
+    // A message bigger than a frame is written here, after the ones queued at its priority
+    bool post(const RpcPriority priority, const int64_t deadline, const MsgPack::Packer& packer) {
+        const size_t size = packer.size();
+        if (size <= BridgeTxQueue::capacity()) {
+            const int index = tx.take(deadline);
+            if (index < 0) return false;
+            memcpy(tx.data(index), packer.data(), size);
+            tx.post(index, size, priority);
+            return true;
+        }
+
+        if (!lock_in_order(priority, deadline)) return false;
+        const bool ok = transport->write(packer.data(), size) == size;
+        write_lock.unlock();
+        return ok;
+    }
+
+    // Queues [CALL_MSG, msg_id, method, [args...]]. The response is collected with
+    // client->get_response(msg_id) as usual
+    template<typename... Args>
+    bool post_call(const RpcPriority priority, const int64_t deadline, const MsgPack::str_t& method, uint32_t& msg_id, const Args&... args) {
+        msg_id = next_msg_id();
+        MsgPack::Packer packer;
+        packer.packArraySize(4);
+        packer.pack(static_cast<uint8_t>(CALL_MSG));
+        packer.pack(msg_id);
+        packer.pack(method);
+        packer.packArraySize(sizeof...(Args));
+        (packer.pack(args), ...);
+        return post(priority, deadline, packer);
+    }
+
+    // Queues [NOTIFY_MSG, method, [args...]]
+    template<typename... Args>
+    bool post_notify(const RpcPriority priority, const int64_t deadline, const MsgPack::str_t& method, const Args&... args) {
+        MsgPack::Packer packer;
+        packer.packArraySize(3);
+        packer.pack(static_cast<uint8_t>(NOTIFY_MSG));
+        packer.pack(method);
+        packer.packArraySize(sizeof...(Args));
+        (packer.pack(args), ...);
+        return post(priority, deadline, packer);
+    }
+
+    // Writer thread: sends the queued frames, most urgent first, waiting up to timeout for
+    // the first one. The write lock keeps them apart from the messages written directly
+    void write_queued(k_timeout_t timeout) {
+        int index;
+        RpcPriority priority;
+        while (tx.next(index, priority, timeout)) {
+            size_t size;
+            const uint8_t* data = tx.frame(index, size);
+            write_lock.lock(priority);
+            transport->write(data, size);
+            write_lock.unlock();
+            tx.sent(index, priority);
+            timeout = K_NO_WAIT;
+        }
+    }
+
+    // Sends the call [CALL_MSG, msg_id, method, [head..., bin]] keeping only the envelope
+    // in RAM: the payload goes to the transport straight from data, which may be a const
+    // table in flash. The response is collected with client->get_response(msg_id) as usual.
+    // Must be used holding the write lock
+    template<typename... Head>
+    bool send_view(const MsgPack::str_t& method, uint32_t& msg_id, const uint8_t* data, size_t size, const Head&... head) {
+        msg_id = next_msg_id();
+
+        MsgPack::Packer envelope;
+        envelope.packArraySize(4);
+        envelope.pack(static_cast<uint8_t>(CALL_MSG));
+        envelope.pack(msg_id);
+        envelope.pack(method);
+        envelope.packArraySize(sizeof...(Head) + 1);
+        (envelope.pack(head), ...);
+        envelope.packBinarySize(size);
+
+        if (framed) framed->begin_frame(envelope.size() + size);
+        if (transport->write(envelope.data(), envelope.size()) != envelope.size()) return false;
+
+        // A short write here leaves a truncated frame, which the router drops
+        return write_view(data, size);
+    }
+
+    // Hands size bytes of data to the transport in BRIDGE_VIEW_CHUNK byte chunks.
+    // Must be used holding the write lock
+    bool write_view(const uint8_t* data, size_t size) {
+        while (size > 0) {
+            const size_t chunk = size < BRIDGE_VIEW_CHUNK ? size : BRIDGE_VIEW_CHUNK;
+            const size_t written = transport->write(data, chunk);
+            if (written == 0) return false;
+            data += written;
+            size -= written;
+        }
+        return true;
+    }
+};
 
 template<typename... Args>
 class RpcCall {
@@ -48,11 +705,30 @@ class RpcCall {
 
 public:
 
-    RpcCall(const MsgPack::str_t& m, RPCClient* c, struct k_mutex* rm, struct k_mutex* wm, Args&&... args): method(m), client(c), read_mutex(rm), write_mutex(wm), callback_params(std::forward_as_tuple(std::forward<Args>(args)...)) {
+    RpcCall(const MsgPack::str_t& m, RpcChannel* ch, RpcPriority p, Args&&... args): method(m), channel(ch), priority(p), timeout_ms(atomic_get(&ch->default_timeout)), callback_params(std::forward_as_tuple(std::forward<Args>(args)...)) {
         k_mutex_init(&call_mutex);
         setError(GENERIC_ERR, "This call is not yet executed");
     }
 
+    // A copy would execute the call twice
+    RpcCall(const RpcCall&) = delete;
+    RpcCall& operator=(const RpcCall&) = delete;
+
+    // Upper bound for result(), counted from when the call is sent. 0 waits forever
+    RpcCall& setTimeout(uint32_t ms) {
+        timeout_ms = ms;
+        return *this;
+    }
+
+    // Gives up the call. A pending result() returns false with CANCELLED_ERR,
+    // a late response from the router is discarded
+    void cancel() {
+        atomic_set(&_cancelled, 1);
+        if (atomic_cas(&_executed, 0, 1)) {
+            setError(CANCELLED_ERR, "This call was cancelled");
+        }
+    }
+
     bool isError() {
         k_mutex_lock(&call_mutex, K_FOREVER);
         const bool out = error.code > NO_ERR;
@@ -77,37 +753,70 @@ public:
     template<typename RType> bool result(RType& result) {
 
         if (!atomic_cas(&_executed, 0, 1)){
-            // this thread lost the race
-            setError(GENERIC_ERR, "This call is no longer available");
+            // already executed or cancelled: the first outcome stays
             return false;
         }
 
-        while (true) {
-            if (k_mutex_lock(write_mutex, K_MSEC(10)) == 0) {
-                std::apply([this](const auto&... elems) {
-                    client->send_rpc(method, msg_id_wait, elems...);
-                }, callback_params);
-                k_mutex_unlock(write_mutex);
-                break;
-            } else {
-                k_yield();
-            }
+        const int64_t deadline = timeout_ms > 0 ? k_uptime_get() + timeout_ms : 0;
+        // a frame dropped from now on may have been the response
+        const atomic_val_t link_errors = atomic_get(&channel->link_errors);
+
+        const bool sent = std::apply([this, deadline](const auto&... elems) {
+            return channel->post_call(priority, deadline, method, msg_id_wait, elems...);
+        }, callback_params);
+        if (!sent) {
+            setError(TIMEOUT_ERR, "Timed out waiting for the link");
+            return false;
         }
 
+        bool abandoned = false;     // given up, but no orphan entry took the response
         while(true) {
-            if (k_mutex_lock(read_mutex, K_MSEC(10)) == 0 ) {
+            if (k_mutex_lock(&channel->read_mutex, K_MSEC(10)) == 0 ) {
+                channel->orphans.drain(*channel->client);
                 RpcError temp_err;
-                if (client->get_response(msg_id_wait, result, temp_err)) {
-                    k_mutex_unlock(read_mutex);
+                if (abandoned) {
+                    MsgPack::object::nil_t nil;
+                    if (channel->client->get_response(msg_id_wait, nil, temp_err)
+                        || (!channel->orphans.full() && channel->orphans.add(msg_id_wait))) {
+                        k_mutex_unlock(&channel->read_mutex);
+                        channel->wake_update();
+                        break;
+                    }
+                } else if (channel->client->get_response(msg_id_wait, result, temp_err)) {
+                    k_mutex_unlock(&channel->read_mutex);
+                    channel->heard();
+                    // a request may have been decoded behind the response
+                    channel->wake_update();
                     // if (error.code == PARSING_ERR) {
-                    //     k_mutex_lock(write_mutex, K_FOREVER);
-                    //     client->notify(BRIDGE_ERROR, error.traceback);
-                    //     k_mutex_unlock(write_mutex);
+                    //     channel->write_lock.lock(RPC_PRIORITY_NORMAL);
+                    //     channel->client->notify(BRIDGE_ERROR, error.traceback);
+                    //     channel->write_lock.unlock();
                     // }
                     setError(temp_err.code, temp_err.traceback);
                     break;
                 }
-                k_mutex_unlock(read_mutex);
+
+                const bool cancelled = atomic_get(&_cancelled);
+                const bool lost = atomic_get(&channel->link_errors) != link_errors;
+                if (!abandoned && (cancelled || lost || (deadline > 0 && k_uptime_get() >= deadline))) {
+                    if (cancelled) {
+                        setError(CANCELLED_ERR, "This call was cancelled");
+                    } else if (lost) {
+                        setError(LINK_ERR, "A frame was dropped on the link");
+                    } else {
+                        setError(TIMEOUT_ERR, "Timed out waiting for the response");
+                    }
+                    // the response may still come: leave its msg_id to be discarded. With the
+                    // orphans full, this call stays to discard it
+                    if (channel->orphans.add(msg_id_wait)) {
+                        k_mutex_unlock(&channel->read_mutex);
+                        break;
+                    }
+                    abandoned = true;
+                }
+
+                k_mutex_unlock(&channel->read_mutex);
+                channel->wake_update();
                 k_msleep(1);
             } else {
                 k_yield();
@@ -132,186 +841,1222 @@ public:
 
 private:
     uint32_t msg_id_wait{};
-    atomic_t _executed = ATOMIC_INIT(0);;
+    atomic_t _executed = ATOMIC_INIT(0);
+    atomic_t _cancelled = ATOMIC_INIT(0);
 
     MsgPack::str_t method;
-    RPCClient* client;
-    struct k_mutex* read_mutex;
-    struct k_mutex* write_mutex;
+    RpcChannel* channel;
+    RpcPriority priority;
+    uint32_t timeout_ms;
     struct k_mutex call_mutex{};
     std::tuple<Args...> callback_params;
 };
 
-class BridgeClass {
-
-    RPCClient* client = nullptr;
-    RPCServer* server = nullptr;
-    HardwareSerial* serial_ptr = nullptr;
-    ITransport* transport = nullptr;
-
-    struct k_mutex read_mutex{};
-    struct k_mutex write_mutex{};
-    struct k_mutex bridge_mutex{};
-
-    k_tid_t upd_tid{};
-    k_thread_stack_t *upd_stack_area{};
-    struct k_thread upd_thread_data{};
+// Call whose successful result is kept for ttl_ms and served from the cache meanwhile.
+// The router is only contacted on a miss
+template<typename... Args>
+class CachedRpcCall {
 
-    bool started = false;
+    MsgPack::str_t method;
+    RpcChannel* channel;
+    RpcResultCache<>* cache;
+    uint32_t ttl_ms;
+    std::tuple<Args...> callback_params;
+    RpcError error{GENERIC_ERR, "This call is not yet executed"};
 
 public:
 
-    explicit BridgeClass(HardwareSerial& serial) {
-        serial_ptr = &serial;
-    }
-
-    operator bool() {
-        return is_started();
-    }
-
-    bool is_started() {
-        k_mutex_lock(&bridge_mutex, K_FOREVER);
-        bool out = started;
-        k_mutex_unlock(&bridge_mutex);
-        return out;
-    }
-
-    // Initialize the bridge
-    bool begin(unsigned long baud=DEFAULT_SERIAL_BAUD) {
-        k_mutex_init(&read_mutex);
-        k_mutex_init(&write_mutex);
-        k_mutex_init(&bridge_mutex);
-
-        if (is_started()) return true;
+    CachedRpcCall(const MsgPack::str_t& m, RpcChannel* ch, RpcResultCache<>* c, uint32_t ttl, Args&&... args): method(m), channel(ch), cache(c), ttl_ms(ttl), callback_params(std::forward_as_tuple(std::forward<Args>(args)...)) {}
 
-        k_mutex_lock(&bridge_mutex, K_FOREVER);
+    template<typename RType> bool result(RType& result) {
 
-        serial_ptr->begin(baud);
-        // This allows Router to flush broken RPCs from the previous run
-        serial_ptr->write("MCU starting RPC Bridge communication");
-        transport = new SerialTransport(*serial_ptr);
+        MsgPack::Packer key;
+        std::apply([this, &key](const auto&... elems) {
+            key.serialize(method, elems...);
+        }, callback_params);
 
-        client = new RPCClient(*transport);
-        server = new RPCServer(*transport);
+        if (cache->get(key, result)) {
+            error = RpcError(NO_ERR, "");
+            return true;
+        }
 
-        upd_stack_area = k_thread_stack_alloc(UPDATE_THREAD_STACK_SIZE, 0);
-        upd_tid = k_thread_create(&upd_thread_data, upd_stack_area,
-                                UPDATE_THREAD_STACK_SIZE,
-                                updateEntryPoint,
-                                NULL, NULL, NULL,
-                                UPDATE_THREAD_PRIORITY, 0, K_NO_WAIT);
-        k_thread_name_set(upd_tid, "bridge");
+        bool ok = std::apply([this, &result](const auto&... elems) {
+            RpcCall<const Args&...> call(method, channel, RPC_PRIORITY_NORMAL, elems...);
+            const bool out = call.result(result);
+            error = RpcError(call.getErrorCode(), call.getErrorMessage());
+            return out;
+        }, callback_params);
+
+        if (ok) {
+            MsgPack::Packer value;
+            value.serialize(result);
+            cache->put(key, value, ttl_ms);
+        }
 
-        bool res = false;
-        started = call(RESET_METHOD).result(res) && res;
-        k_mutex_unlock(&bridge_mutex);
-        return res;
+        return ok;
     }
 
-    bool getRouterVersion(MsgPack::str_t& version) {
-        return call(GET_VERSION_METHOD).result(version);
+    bool isError() const {
+        return error.code > NO_ERR;
     }
 
-    template<typename F>
-    bool provide(const MsgPack::str_t& name, F&& func) {
-        k_mutex_lock(&bridge_mutex, K_FOREVER);
-        bool res;
-        bool out = call(BIND_METHOD, name).result(res) && res && server->bind(name, func);
-        k_mutex_unlock(&bridge_mutex);
-        return out;
+    int getErrorCode() const {
+        return error.code;
     }
 
-    template<typename F>
-    bool provide_safe(const MsgPack::str_t& name, F&& func) {
-        k_mutex_lock(&bridge_mutex, K_FOREVER);
-        bool res;
-        bool out = call(BIND_METHOD, name).result(res) && res && server->bind(name, func, "__safe__");
-        k_mutex_unlock(&bridge_mutex);
-        return out;
+    MsgPack::str_t getErrorMessage() const {
+        return error.traceback;
     }
 
-    void update() {
+};
 
-        // Lock read mutex
-        if (k_mutex_lock(&read_mutex, K_MSEC(10)) != 0 ) return;
+// Final response of a streamed method, once all its chunks are out. The router answers the
+// caller with the items of every chunk instead, and with an error when complete is false
+// or a chunk is missing
+struct BridgeStreamEnd {
+    uint32_t items = 0;
+    uint32_t chunks = 0;
+    bool complete = true;
 
-        RPCRequest<> req;
-        if (!server->get_rpc(req)) {
-            k_mutex_unlock(&read_mutex);
-            k_msleep(1);
-            return;
+    MSGPACK_DEFINE(items, chunks, complete); // -> [items, chunks, complete]
+};
+
+// Handed to a provide_stream method to produce its result piece by piece. Items are packed
+// in a buffer that goes out as a $/partial notification every BRIDGE_STREAM_CHUNK bytes, so
+// a result of any size needs about one chunk of RAM, and the router gets the first items
+// while the rest is still being produced
+class BridgeResponseWriter {
+
+    RpcChannel* channel;
+    uint32_t msg_id;
+    MsgPack::Packer batch;
+    uint32_t batch_items = 0;
+    BridgeStreamEnd end{};
+
+    // [NOTIFY_MSG, PARTIAL_METHOD, [msg_id, seq, [batch..., bin(data)]]]. The payload of
+    // data, if any, goes to the link straight from the caller's memory
+    bool send(const uint8_t* data=nullptr, size_t size=0) {
+        if (data) {
+            batch.packBinarySize(size);
+            batch_items++;
         }
 
-        k_mutex_unlock(&read_mutex);
+        MsgPack::Packer envelope;
+        envelope.packArraySize(3);
+        envelope.pack(static_cast<uint8_t>(NOTIFY_MSG));
+        envelope.pack(MsgPack::str_t(PARTIAL_METHOD));
+        envelope.packArraySize(3);
+        envelope.pack(msg_id);
+        envelope.pack(end.chunks);
+        envelope.packArraySize(batch_items);
+
+        channel->lock_in_order(RPC_PRIORITY_NORMAL);
+        if (channel->framed) channel->framed->begin_frame(envelope.size() + batch.size() + size);
+        bool ok = channel->transport->write(envelope.data(), envelope.size()) == envelope.size()
+            && channel->transport->write(batch.data(), batch.size()) == batch.size()
+            && channel->write_view(data, size);
+        channel->write_lock.unlock();
+
+        end.items += batch_items;
+        end.chunks++;
+        batch.clear();
+        batch_items = 0;
+        if (!ok) end.complete = false;
+        return ok;
+    }
 
-        server->process_request(req);
+public:
 
-        // Lock write mutex
-        while (true) {
+    BridgeResponseWriter(RpcChannel& ch, uint32_t id): channel(&ch), msg_id(id) {}
 
-            if (k_mutex_lock(&write_mutex, K_MSEC(10)) == 0){
-                server->send_response(req);
-                k_mutex_unlock(&write_mutex);
-                break;
-            } else {
-                k_yield();
-            }
+    // Adds one item per value. Returns false once the response failed
+    template<typename... T>
+    bool write(const T&... values) {
+        if (!end.complete) return false;
+        (batch.pack(values), ...);
+        batch_items += sizeof...(T);
+        return batch.size() < BRIDGE_STREAM_CHUNK || send();
+    }
 
+    // Adds the bytes as bin items of at most BRIDGE_STREAM_CHUNK bytes, sent from data
+    // without a copy. The router joins a result made of bin items only into one bin
+    bool write_bytes(const uint8_t* data, size_t size) {
+        while (size > 0 && end.complete) {
+            const size_t chunk = size < BRIDGE_STREAM_CHUNK ? size : BRIDGE_STREAM_CHUNK;
+            send(data, chunk);
+            data += chunk;
+            size -= chunk;
         }
+        return end.complete;
+    }
 
+    // Sends the items written so far without waiting for a full chunk
+    bool flush() {
+        if (!end.complete) return false;
+        return batch_items == 0 || send();
     }
 
-    template<typename... Args>
-    RpcCall<Args...> call(const MsgPack::str_t& method, Args&&... args) {
-       return RpcCall<Args...>(method, client, &read_mutex, &write_mutex, std::forward<Args>(args)...);
+    // The caller gets an error instead of a partial result
+    void fail() {
+        end.complete = false;
     }
 
-    template<typename... Args>
-    void notify(const MsgPack::str_t method, Args&&... args)  {
-        while (true) {
-            if (k_mutex_lock(&write_mutex, K_MSEC(10)) == 0) {
-                client->notify(method, std::forward<Args>(args)...);
-                k_mutex_unlock(&write_mutex);
-                break;
-            }
-            k_yield();
-        }
+    bool isError() const {
+        return !end.complete;
     }
 
-private:
+    // An empty result still sends one chunk: it is what tells the router that the
+    // response is streamed
+    BridgeStreamEnd finish() {
+        if (end.complete && (batch_items > 0 || end.chunks == 0)) send();
+        return end;
+    }
 
-    void update_safe() {
+};
 
-        // Lock read mutex
-        if (k_mutex_lock(&read_mutex, K_MSEC(10)) != 0 ) return;
+// Arguments of a provide_stream method, after its leading BridgeResponseWriter&
+template<typename... A>
+struct StreamArgs {};
 
-        RPCRequest<> req;
-        if (!server->get_rpc(req, "__safe__")) {
-            k_mutex_unlock(&read_mutex);
-            k_msleep(1);
-            return;
-        }
+template<typename F>
+struct StreamArgsOf : StreamArgsOf<decltype(&F::operator())> {};
 
-        k_mutex_unlock(&read_mutex);
+template<typename R, typename... A>
+struct StreamArgsOf<R(*)(BridgeResponseWriter&, A...)> { using type = StreamArgs<typename std::decay<A>::type...>; };
 
-        server->process_request(req);
+template<typename R, typename C, typename... A>
+struct StreamArgsOf<R(C::*)(BridgeResponseWriter&, A...)> { using type = StreamArgs<typename std::decay<A>::type...>; };
 
-        // Lock write mutex
-        while (true) {
+template<typename R, typename C, typename... A>
+struct StreamArgsOf<R(C::*)(BridgeResponseWriter&, A...) const> { using type = StreamArgs<typename std::decay<A>::type...>; };
 
-            if (k_mutex_lock(&write_mutex, K_MSEC(10)) == 0){
-                server->send_response(req);
-                k_mutex_unlock(&write_mutex);
-                break;
-            } else {
-                k_yield();
+// A method to expose through BridgeClass::provide_all
+template<typename F>
+struct BridgeMethod {
+    MsgPack::str_t name;
+    F func;
+    bool safe;      // served in the main loop
+};
+
+template<typename F>
+BridgeMethod<typename std::decay<F>::type> bridge_method(const MsgPack::str_t& name, F&& func) {
+    return {name, std::forward<F>(func), false};
+}
+
+// Served in the main loop, like provide_safe
+template<typename F>
+BridgeMethod<typename std::decay<F>::type> bridge_safe_method(const MsgPack::str_t& name, F&& func) {
+    return {name, std::forward<F>(func), true};
+}
+
+// A provide_safe request as decoded by the update thread: the raw message, unpacked
+// again by the main loop when it serves it
+struct BridgeSafeRequest {
+    uint16_t size;
+    uint8_t buffer[DEFAULT_RPC_BUFFER_SIZE];
+};
+
+// Told whether the bridge is connected to the router. Runs in the supervisor thread
+typedef void (*BridgeReadyCallback)(bool ready);
+
+class BridgeClass {
+
+    RpcChannel channel{};
+    RPCServer* server = nullptr;
+    HardwareSerial* serial_ptr = nullptr;
+    ITransport* transport = nullptr;
+
+    struct k_mutex bridge_mutex{};
+    // Guards caps, which a reconnect rewrites while other threads read it
+    struct k_mutex caps_mutex{};
+
+    k_tid_t upd_tid{};
+    k_thread_stack_t *upd_stack_area{};
+    struct k_thread upd_thread_data{};
+
+    k_tid_t sup_tid{};
+    k_thread_stack_t *sup_stack_area{};
+    struct k_thread sup_thread_data{};
+
+    k_tid_t wr_tid{};
+    k_thread_stack_t *wr_stack_area{};
+    struct k_thread wr_thread_data{};
+    atomic_ptr_t ready_callback = ATOMIC_PTR_INIT(nullptr);
+
+#ifdef BRIDGE_STATIC_ALLOCATION
+#ifdef BRIDGE_FRAMED_LINK
+    alignas(BridgeFramedTransport) uint8_t transport_storage[sizeof(BridgeFramedTransport)];
+#else
+    alignas(SerialTransport) uint8_t transport_storage[sizeof(SerialTransport)];
+#endif
+    alignas(RPCClient) uint8_t client_storage[sizeof(RPCClient)];
+    alignas(RPCServer) uint8_t server_storage[sizeof(RPCServer)];
+    K_KERNEL_STACK_MEMBER(upd_stack, UPDATE_THREAD_STACK_SIZE);
+    K_KERNEL_STACK_MEMBER(sup_stack, SUPERVISOR_THREAD_STACK_SIZE);
+    K_KERNEL_STACK_MEMBER(wr_stack, WRITER_THREAD_STACK_SIZE);
+    BridgeSafeRequest safe_storage[BRIDGE_SAFE_QUEUE_SIZE];
+#endif
+
+    atomic_t initialized = ATOMIC_INIT(0);  // 1 while setting up, 2 once done
+
+    // Every set up bridge, served by the main loop hook
+    static inline atomic_ptr_t instances = ATOMIC_PTR_INIT(nullptr);
+    BridgeClass* next_instance = nullptr;
+
+    BridgeClass* bonded[BRIDGE_MAX_BONDED_LINKS]{};
+    atomic_t bonded_count = ATOMIC_INIT(0);
+    atomic_t started = ATOMIC_INIT(0);
+    atomic_t session = ATOMIC_INIT(0);      // bumped by every successful connect()
+    struct k_sem online{};                  // given by connect(), awaited by the update thread while offline
+    struct k_sem supervisor_wake{};         // cuts the heartbeat wait short
+    atomic_t router_hello = ATOMIC_INIT(0);
+    atomic_t link_suspect = ATOMIC_INIT(0);
+    atomic_val_t seen_link_errors = 0;      // update thread only
+    atomic_t rx_events = ATOMIC_INIT(0);
+    uint32_t idle_poll_ms = BRIDGE_IDLE_POLL_MS;    // update thread only
+    bool last_pass_served = true;
+
+    RouterCapabilities caps{};
+    RpcResultCache<> cache{};
+    BridgeProviders providers{};
+    BridgeTelemetry telemetry_table{};
+
+    // Request being served by the update thread and by the main loop, for streamed methods
+    enum { SERVING_UPDATE = 0, SERVING_SAFE, SERVING_COUNT };
+    const RPCRequest<>* serving[SERVING_COUNT]{};
+
+    // Guards providers against provides() reading it while provide() grows it
+    mutable struct k_mutex providers_mutex{};
+
+    // Slots filled by the update thread, whose indexes the main loop takes from safe_queue
+    // without ever waiting. safe_free has a bit set per slot not in use
+    static_assert(BRIDGE_SAFE_QUEUE_SIZE > 0 && BRIDGE_SAFE_QUEUE_SIZE <= 32, "BRIDGE_SAFE_QUEUE_SIZE must be 1 to 32");
+    BridgeSafeRequest* safe_slots = nullptr;
+    atomic_t safe_free = ATOMIC_INIT(0);
+    struct k_msgq safe_queue{};
+    char safe_queue_buffer[BRIDGE_SAFE_QUEUE_SIZE];
+
+public:
+
+    explicit BridgeClass(HardwareSerial& serial) {
+        serial_ptr = &serial;
+    }
+
+    operator bool() {
+        return is_started();
+    }
+
+    bool is_started() const {
+        return atomic_get(&started);
+    }
+
+    // Initialize the bridge and wait for the first connection attempt.
+    // If it fails the supervisor keeps trying in the background
+    bool begin(unsigned long baud=DEFAULT_SERIAL_BAUD) {
+        setup(baud);
+        return connect();
+    }
+
+    // Returns at once: the supervisor connects in the background and calls back
+    // with true once the bridge is usable. It calls back with false if the router
+    // stops answering, and with true again once it is back and every provided
+    // method is registered again
+    void begin_async(BridgeReadyCallback callback=nullptr, unsigned long baud=DEFAULT_SERIAL_BAUD) {
+        atomic_ptr_set(&ready_callback, reinterpret_cast<void*>(callback));
+        setup(baud);
+        if (callback && is_started()) callback(true);
+    }
+
+    // Cached by begin() and refreshed on reconnect, so a copy is returned
+    RouterCapabilities capabilities() {
+        k_mutex_lock(&caps_mutex, K_FOREVER);
+        RouterCapabilities out = caps;
+        k_mutex_unlock(&caps_mutex);
+        return out;
+    }
+
+    // Single field read, for hot paths that should not copy the version string
+    template<typename T>
+    T capability(T RouterCapabilities::* field) {
+        k_mutex_lock(&caps_mutex, K_FOREVER);
+        const T out = caps.*field;
+        k_mutex_unlock(&caps_mutex);
+        return out;
+    }
+
+    // Largest payload to put in a single bulk call
+    size_t max_frame_payload() {
+        const size_t max_frame = capability(&RouterCapabilities::max_frame);
+        if (max_frame > 0 && max_frame < BRIDGE_MAX_FRAME_PAYLOAD) {
+            return max_frame;
+        }
+        return BRIDGE_MAX_FRAME_PAYLOAD;
+    }
+
+    // Deadline for every call that does not set its own, 0 waits forever
+    void setDefaultTimeout(uint32_t ms) {
+        atomic_set(&channel.default_timeout, ms);
+    }
+
+    uint32_t getDefaultTimeout() const {
+        return atomic_get(&channel.default_timeout);
+    }
+
+    // Abandoned calls that found the orphan table full, so they had to wait for their response
+    uint32_t getOrphanOverflows() const {
+        return channel.orphans.overflowed();
+    }
+
+    // ISR-safe: signals that bytes were received on the link. Once a UART RX
+    // interrupt reports here, the update thread sleeps until the next event
+    // instead of polling the UART buffer every BRIDGE_IDLE_POLL_MS
+    void rx_event() {
+        atomic_set(&rx_events, 1);
+        channel.wake_update();
+    }
+
+    // Adds link, begun on its own UART, as a carrier of bulk payloads (tcp/udp data).
+    // Control calls stay on this bridge. Call after begin()
+    bool bond(BridgeClass& link) {
+        if (&link == this || atomic_get(&initialized) != 2) return false;
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        const size_t n = atomic_get(&bonded_count);
+        const bool ok = n < BRIDGE_MAX_BONDED_LINKS;
+        if (ok) {
+            bonded[n] = &link;
+            atomic_set(&bonded_count, n + 1);
+        }
+        k_mutex_unlock(&bridge_mutex);
+        return ok;
+    }
+
+    // Link carrying the payloads of connection_id. Connections are spread over the
+    // bonded links, but all the payloads of one connection take the same link, so
+    // the router gets them in order. A link that is down falls back to this bridge
+    BridgeClass& bulk_link(uint32_t connection_id) {
+        const size_t n = atomic_get(&bonded_count);
+        if (n == 0) return *this;
+        const size_t pick = connection_id % (n + 1);
+        BridgeClass* link = pick == 0 ? this : bonded[pick - 1];
+        return link->is_started() ? *link : *this;
+    }
+
+    // Has the router forward between two open connections (tcp, udp or SPLICE_MONITOR_ID)
+    // by itself: their bytes no longer cross the link. Do not read or write the spliced
+    // connections from the MCU until the splice is stopped
+    bool splice(uint32_t src_id, uint32_t dst_id, uint8_t options, uint32_t& splice_id) {
+        return call(SPLICE_START_METHOD, src_id, dst_id, options).result(splice_id);
+    }
+
+    bool spliceStats(uint32_t splice_id, BridgeSpliceStats& stats) {
+        return call(SPLICE_STATS_METHOD, splice_id).result(stats);
+    }
+
+    // The connections stay open and usable from the MCU again
+    bool unsplice(uint32_t splice_id, BridgeSpliceStats& stats) {
+        return call(SPLICE_STOP_METHOD, splice_id).result(stats);
+    }
+
+    // Readiness of every connection in set in one round trip. The router answers as soon as
+    // one has an event it asked for, or after timeout_ms (0 answers at once). Returns how many
+    // have one, closed and unknown ones included; -1 when the call failed
+    template<size_t N>
+    int poll(BridgePollSet<N>& set, uint32_t timeout_ms=0) {
+        MsgPack::arr_t<BridgePollStatus> answer;
+        auto rpc = call(POLL_METHOD, set.request(), timeout_ms);
+        // the router side wait comes on top of the usual deadline
+        const uint32_t timeout = getDefaultTimeout();
+        if (timeout > 0) rpc.setTimeout(timeout + timeout_ms);
+        if (!rpc.result(answer)) return -1;
+        return set.update(answer);
+    }
+
+    bool getRouterVersion(MsgPack::str_t& version) {
+        return call(GET_VERSION_METHOD).result(version);
+    }
+
+    // Stores a PEM CA bundle on the router once, for every client of this bridge.
+    // pem must stay valid while the handle is in use
+    bool registerCA(const char* pem, BridgeCAHandle& handle) {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        handle.pem = pem;
+        handle.valid = register_ca(handle);
+        k_mutex_unlock(&bridge_mutex);
+        return handle.valid;
+    }
+
+    bool unregisterCA(BridgeCAHandle& handle) {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        bool ok = handle.valid;
+        // A restarted router already forgot it
+        if (ok && handle.session == router_session()) {
+            bool res = false;
+            ok = call(TCP_UNREGISTER_CA_METHOD, handle.id).result(res) && res;
+        }
+        if (ok) handle.valid = false;
+        k_mutex_unlock(&bridge_mutex);
+        return ok;
+    }
+
+    // Id of the bundle in the current router session, registered again after a restart
+    bool ca_id(BridgeCAHandle& handle, uint32_t& id) {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        bool ok = handle.valid && (handle.session == router_session() || register_ca(handle));
+        id = handle.id;
+        k_mutex_unlock(&bridge_mutex);
+        return ok;
+    }
+
+    uint32_t router_session() const {
+        return atomic_get(&session);
+    }
+
+    template<typename F>
+    bool provide(const MsgPack::str_t& name, F&& func) {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        // While disconnected the name is registered by the next connect()
+        bool out = can_provide(name) && (!is_started() || register_name(name)) && server->bind(name, func) && insert_provider(name, false);
+        k_mutex_unlock(&bridge_mutex);
+        return out;
+    }
+
+    template<typename F>
+    bool provide_safe(const MsgPack::str_t& name, F&& func) {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        bool out = can_provide(name) && (!is_started() || register_name(name)) && server->bind(name, func, SAFE_TAG) && insert_provider(name, true);
+        k_mutex_unlock(&bridge_mutex);
+        return out;
+    }
+
+    // For results too big to build in RAM: func(BridgeResponseWriter& out, args...) writes
+    // them piece by piece with out.write(values...) and out.write_bytes(data, size), and the
+    // router puts them back together. Served by the update thread, like provide
+    template<typename F>
+    bool provide_stream(const MsgPack::str_t& name, F&& func) {
+        using Handler = typename std::decay<F>::type;
+        return provide(name, stream_wrapper(Handler(std::forward<F>(func)), SERVING_UPDATE, typename StreamArgsOf<Handler>::type{}));
+    }
+
+    // provide_stream served in the main loop, like provide_safe
+    template<typename F>
+    bool provide_stream_safe(const MsgPack::str_t& name, F&& func) {
+        using Handler = typename std::decay<F>::type;
+        return provide_safe(name, stream_wrapper(Handler(std::forward<F>(func)), SERVING_SAFE, typename StreamArgsOf<Handler>::type{}));
+    }
+
+    bool provides(const MsgPack::str_t& name) const {
+        k_mutex_lock(&providers_mutex, K_FOREVER);
+        const bool out = providers.contains(name);
+        k_mutex_unlock(&providers_mutex);
+        return out;
+    }
+
+    // Registers every method with a single $/registerBatch call when the router supports
+    // batching, then binds them all locally. E.g.
+    // Bridge.provide_all(bridge_method("set_led", set_led), bridge_safe_method("greet", greet));
+    template<typename... F>
+    bool provide_all(BridgeMethod<F>... methods) {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+
+        // Refused as a whole, before any router traffic, if a name is taken or would not fit
+        bool out = (can_provide(methods.name) && ...) && providers.fits(sizeof...(F));
+        if (out && is_started() && capability(&RouterCapabilities::batching)) {
+            MsgPack::arr_t<MsgPack::str_t> names;
+            names.reserve(sizeof...(F));
+            (names.push_back(methods.name), ...);
+            bool res = false;
+            out = call(BIND_BATCH_METHOD, names).result(res) && res;
+        } else if (out && is_started()) {
+            out = (register_name(methods.name) && ...);
+        }
+
+        out = out && ((server->bind(methods.name, methods.func, methods.safe ? SAFE_TAG : "") && insert_provider(methods.name, methods.safe)) && ...);
+
+        k_mutex_unlock(&bridge_mutex);
+        return out;
+    }
+
+    // Serves one pending request, if any, or hands a provide_safe one to the main loop.
+    // Returns false when there was none
+    bool update() {
+
+        // Lock read mutex
+        if (k_mutex_lock(&channel.read_mutex, K_MSEC(10)) != 0 ) return false;
+
+        // Late responses to abandoned calls would otherwise sit in front of requests
+        channel.orphans.drain(*channel.client);
+
+        // get_rpc only looks at the method name of the message in the decoder, and takes it
+        // off when the name is bound with the tag asked for. The request headers are unpacked
+        // once, by process_request, in the thread that serves it
+        RPCRequest<> req;
+        if (server->get_rpc(req)) {
+            k_mutex_unlock(&channel.read_mutex);
+            serve(req, SERVING_UPDATE);
+            return true;
+        }
+
+        // A provide_safe request leaves the decoder only once it has a slot.
+        // The main loop wakes this thread when it frees one
+        const bool safe = providers.safe_size() > 0 && atomic_get(&safe_free) != 0 && server->get_rpc(req, SAFE_TAG);
+
+        k_mutex_unlock(&channel.read_mutex);
+
+        if (safe) queue_safe(req);
+        return safe;
+    }
+
+    template<typename... Args>
+    RpcCall<Args...> call(const MsgPack::str_t& method, Args&&... args) {
+       return RpcCall<Args...>(method, &channel, RPC_PRIORITY_NORMAL, std::forward<Args>(args)...);
+    }
+
+    template<typename... Args>
+    RpcCall<Args...> call_priority(RpcPriority priority, const MsgPack::str_t& method, Args&&... args) {
+       return RpcCall<Args...>(method, &channel, priority, std::forward<Args>(args)...);
+    }
+
+    // Sends at once and returns. callback(result, error) runs in the update thread when
+    // the response arrives, or with TIMEOUT_ERR after the default timeout; error.code is
+    // NO_ERR on success. The callback must not wait on other calls, but may call_async.
+    // Returns false, without calling back, when the call could not be sent
+    template<typename F, typename... Args>
+    bool call_async(const MsgPack::str_t& method, F&& callback, Args&&... args) {
+        RpcAsyncCalls::Ticket ticket;
+        return call_async(ticket, method, std::forward<F>(callback), std::forward<Args>(args)...);
+    }
+
+    // Same, and fills ticket for cancel_async()
+    template<typename F, typename... Args>
+    bool call_async(RpcAsyncCalls::Ticket& ticket, const MsgPack::str_t& method, F&& callback, Args&&... args) {
+        using RType = typename AsyncResultOf<typename std::decay<F>::type>::type;
+
+        RpcAsyncCalls::Handle slot = channel.async.claim();
+        if (!slot) return false;
+
+        const uint32_t timeout = atomic_get(&channel.default_timeout);
+        const int64_t deadline = timeout > 0 ? k_uptime_get() + timeout : 0;
+
+        const atomic_val_t link_errors = atomic_get(&channel.link_errors);
+        uint32_t msg_id;
+        if (!channel.post_call(RPC_PRIORITY_NORMAL, deadline, method, msg_id, args...)) {
+            channel.async.release(slot);
+            return false;
+        }
+
+        channel.async.arm<RType>(slot, msg_id, deadline, link_errors, std::forward<F>(callback));
+        ticket.slot = slot;
+        ticket.msg_id = msg_id;
+        return true;
+    }
+
+    // The callback of a call_async call still waiting runs soon with CANCELLED_ERR, in the
+    // update thread. Its late response is discarded
+    void cancel_async(const RpcAsyncCalls::Ticket& ticket) {
+        if (!ticket.slot) return;
+        channel.async.cancel(ticket);
+        channel.wake_update();
+    }
+
+#ifdef BRIDGE_HAS_COROUTINES
+    // auto v = co_await Bridge.call_co<float>("sensor/read"); inside a BridgeTask.
+    // The coroutine is resumed by BridgeTasks.run()
+    template<typename RType, typename... Args>
+    RpcAwaitable<RType> call_co(const MsgPack::str_t& method, Args&&... args);
+#endif
+
+    // For idempotent methods: the result is reused for ttl_ms without contacting the router
+    template<typename... Args>
+    CachedRpcCall<Args...> call_cached(uint32_t ttl_ms, const MsgPack::str_t& method, Args&&... args) {
+       return CachedRpcCall<Args...>(method, &channel, &cache, ttl_ms, std::forward<Args>(args)...);
+    }
+
+    void invalidate_cache() {
+        cache.clear();
+    }
+
+    template<typename... Args>
+    void notify(const MsgPack::str_t method, Args&&... args)  {
+        notify_priority(RPC_PRIORITY_NORMAL, method, std::forward<Args>(args)...);
+    }
+
+    // Returns once the message is queued for the writer thread
+    template<typename... Args>
+    void notify_priority(RpcPriority priority, const MsgPack::str_t method, Args&&... args)  {
+        channel.post_notify(priority, 0, method, args...);
+    }
+
+    // ISR-safe: packs the notification in a free frame, without the heap or any lock, and
+    // the writer thread sends it ahead of normal traffic. Arguments are limited to scalars
+    // and C strings, e.g. Bridge.notify_from_isr("button", pin, level). Returns false, and
+    // the notification is lost, when no frame is free or it does not fit in one
+    template<typename... Args>
+    bool notify_from_isr(const char* method, const Args&... args) {
+        if (atomic_get(&initialized) != 2) return false;
+        const int index = channel.tx.try_take();
+        if (index < 0) return false;
+
+        BridgeFrameEncoder frame(channel.tx.data(index), BridgeTxQueue::capacity());
+        frame.packArraySize(3);
+        frame.pack(static_cast<uint8_t>(NOTIFY_MSG));
+        frame.pack(method);
+        frame.packArraySize(sizeof...(Args));
+        (frame.pack(args), ...);
+        if (!frame.ok()) {
+            channel.tx.release(index);
+            return false;
+        }
+
+        channel.tx.post(index, frame.size(), RPC_PRIORITY_REALTIME);
+        return true;
+    }
+
+    // Rate and content of the notify_latest notifications of method: at most one every
+    // interval_ms, carrying TELEMETRY_LATEST, _MIN, _MAX, _MEAN or _STATS (min, max, mean,
+    // count) of the values given since the previous one
+    bool telemetry(const char* method, uint32_t interval_ms, BridgeAggregate aggregate=TELEMETRY_LATEST) {
+        return telemetry_table.configure(method, 0, false, interval_ms, aggregate);
+    }
+
+    // Same, for the notify_latest(method, key, value) updates of one key
+    bool telemetry(const char* method, uint32_t key, uint32_t interval_ms, BridgeAggregate aggregate=TELEMETRY_LATEST) {
+        return telemetry_table.configure(method, key, true, interval_ms, aggregate);
+    }
+
+    // ISR-safe. The value replaces, or is aggregated with, the one of method not sent yet,
+    // so the link carries at most one notification per interval whatever the update rate.
+    // Methods not set up with telemetry() send their latest value every
+    // BRIDGE_TELEMETRY_INTERVAL_MS. Returns false when the telemetry table is full
+    bool notify_latest(const char* method, double value) {
+        return post_latest(method, 0, false, value);
+    }
+
+    // Sent as notify(method, key, value): one slot, and one rate, per key
+    bool notify_latest(const char* method, uint32_t key, double value) {
+        return post_latest(method, key, true, value);
+    }
+
+private:
+
+    bool post_latest(const char* method, uint32_t key, bool keyed, double value) {
+        if (atomic_get(&initialized) != 2) return false;
+        bool due = false;
+        if (!telemetry_table.update(method, key, keyed, value, due)) return false;
+        if (due) channel.tx.wake();
+        return true;
+    }
+
+    // Bound in place of a streamed method: its chunks carry the msg id of the request being
+    // served, and the final response is their count
+    template<typename Handler, typename... A>
+    auto stream_wrapper(Handler handler, uint8_t mode, StreamArgs<A...>) {
+        return [this, handler, mode](A... args) mutable -> BridgeStreamEnd {
+            BridgeResponseWriter out(channel, serving[mode]->msg_id);
+            handler(out, args...);
+            return out.finish();
+        };
+    }
+
+    // Duplicates are refused before costing a $/register round trip
+    bool can_provide(const MsgPack::str_t& name) const {
+        return providers.fits(1) && !providers.contains(name);
+    }
+
+    bool register_name(const MsgPack::str_t& name) {
+        bool res = false;
+        return call(BIND_METHOD, name).result(res) && res;
+    }
+
+    // Link, client, server and threads. Done once, whatever the number of begin() calls
+    void setup(unsigned long baud) {
+        if (!atomic_cas(&initialized, 0, 1)) {
+            while (atomic_get(&initialized) != 2) k_yield();
+            return;
+        }
+
+        channel.init();
+        cache.init();
+        k_msgq_init(&safe_queue, safe_queue_buffer, sizeof(uint8_t), BRIDGE_SAFE_QUEUE_SIZE);
+        k_mutex_init(&bridge_mutex);
+        k_mutex_init(&providers_mutex);
+        k_mutex_init(&caps_mutex);
+        k_sem_init(&online, 0, 1);
+        k_sem_init(&supervisor_wake, 0, 1);
+
+        serial_ptr->begin(baud);
+#ifndef BRIDGE_FRAMED_LINK
+        // This allows Router to flush broken RPCs from the previous run. A framed link
+        // resynchronizes on its own and does not need it
+        serial_ptr->write("MCU starting RPC Bridge communication");
+#endif
+
+#ifdef BRIDGE_STATIC_ALLOCATION
+#ifdef BRIDGE_FRAMED_LINK
+        channel.framed = new (transport_storage) BridgeFramedTransport(*serial_ptr, &channel.link_errors);
+        transport = channel.framed;
+#else
+        transport = new (transport_storage) SerialTransport(*serial_ptr);
+#endif
+        channel.client = new (client_storage) RPCClient(*transport);
+        channel.transport = transport;
+        server = new (server_storage) RPCServer(*transport);
+        server->bind(HELLO_METHOD, [this]() { hello(); });
+        upd_stack_area = upd_stack;
+        sup_stack_area = sup_stack;
+        wr_stack_area = wr_stack;
+        const size_t upd_stack_size = K_KERNEL_STACK_SIZEOF(upd_stack);
+        const size_t sup_stack_size = K_KERNEL_STACK_SIZEOF(sup_stack);
+        const size_t wr_stack_size = K_KERNEL_STACK_SIZEOF(wr_stack);
+#else
+#ifdef BRIDGE_FRAMED_LINK
+        channel.framed = new BridgeFramedTransport(*serial_ptr, &channel.link_errors);
+        transport = channel.framed;
+#else
+        transport = new SerialTransport(*serial_ptr);
+#endif
+        channel.client = new RPCClient(*transport);
+        channel.transport = transport;
+        server = new RPCServer(*transport);
+        server->bind(HELLO_METHOD, [this]() { hello(); });
+        upd_stack_area = k_thread_stack_alloc(UPDATE_THREAD_STACK_SIZE, 0);
+        sup_stack_area = k_thread_stack_alloc(SUPERVISOR_THREAD_STACK_SIZE, 0);
+        wr_stack_area = k_thread_stack_alloc(WRITER_THREAD_STACK_SIZE, 0);
+        const size_t upd_stack_size = UPDATE_THREAD_STACK_SIZE;
+        const size_t sup_stack_size = SUPERVISOR_THREAD_STACK_SIZE;
+        const size_t wr_stack_size = WRITER_THREAD_STACK_SIZE;
+#endif
+
+        wr_tid = k_thread_create(&wr_thread_data, wr_stack_area,
+                                wr_stack_size,
+                                writerEntryPoint,
+                                this, NULL, NULL,
+                                WRITER_THREAD_PRIORITY, 0, K_NO_WAIT);
+        k_thread_name_set(wr_tid, "bridge_tx");
+
+        upd_tid = k_thread_create(&upd_thread_data, upd_stack_area,
+                                upd_stack_size,
+                                updateEntryPoint,
+                                this, NULL, NULL,
+                                UPDATE_THREAD_PRIORITY, 0, K_NO_WAIT);
+        k_thread_name_set(upd_tid, "bridge");
+
+        void* head;
+        do {
+            head = atomic_ptr_get(&instances);
+            next_instance = static_cast<BridgeClass*>(head);
+        } while (!atomic_ptr_cas(&instances, head, this));
+
+        atomic_set(&initialized, 2);
+
+        sup_tid = k_thread_create(&sup_thread_data, sup_stack_area,
+                                sup_stack_size,
+                                supervisorEntryPoint,
+                                this, NULL, NULL,
+                                SUPERVISOR_THREAD_PRIORITY, 0, K_NO_WAIT);
+        k_thread_name_set(sup_tid, "bridge_sup");
+    }
+
+    // $/reset, capabilities and the replay of every provided method
+    bool connect() {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        if (is_started()) {
+            k_mutex_unlock(&bridge_mutex);
+            return true;
+        }
+
+        bool res = false;
+        bool ok = call(RESET_METHOD).setTimeout(BRIDGE_CONNECT_TIMEOUT_MS).result(res) && res;
+        // Cached results may not survive a router reset
+        cache.clear();
+        if (ok) {
+            load_capabilities();
+            ok = register_providers();
+        }
+        if (ok) {
+            atomic_inc(&session);
+            atomic_set(&router_hello, 0);
+            channel.heard();
+        }
+        atomic_set(&started, ok);
+        k_mutex_unlock(&bridge_mutex);
+        if (ok) k_sem_give(&online);
+
+        if (ok) report(true);
+        return ok;
+    }
+
+    bool register_ca(BridgeCAHandle& handle) {
+        handle.session = router_session();
+        return call(TCP_REGISTER_CA_METHOD, handle.pem).result(handle.id);
+    }
+
+    // A fresh router knows none of the names provided so far
+    bool register_providers() {
+        if (providers.size() == 0) return true;
+
+        if (capability(&RouterCapabilities::batching)) {
+            MsgPack::arr_t<MsgPack::str_t> names;
+            names.reserve(providers.size());
+            providers.for_each([&names](const BridgeProvidedMethod& m) {
+                names.push_back(m.name);
+            });
+            bool res = false;
+            return call(BIND_BATCH_METHOD, names).result(res) && res;
+        }
+
+        bool ok = true;
+        providers.for_each([this, &ok](const BridgeProvidedMethod& m) {
+            ok = register_name(m.name) && ok;
+        });
+        return ok;
+    }
+
+    // Any reply proves the router is there, even an error from one lacking $/version
+    bool router_alive() {
+        MsgPack::str_t version;
+        auto heartbeat = call_priority(RPC_PRIORITY_REALTIME, GET_VERSION_METHOD);
+        heartbeat.setTimeout(BRIDGE_HEARTBEAT_TIMEOUT_MS).result(version);
+        return heartbeat.getErrorCode() != TIMEOUT_ERR;
+    }
+
+    void link_lost() {
+        k_mutex_lock(&bridge_mutex, K_FOREVER);
+        atomic_set(&started, 0);
+        k_sem_reset(&online);
+        cache.clear();
+        k_mutex_unlock(&bridge_mutex);
+
+        report(false);
+    }
+
+    void report(bool ready) {
+        const BridgeReadyCallback callback = reinterpret_cast<BridgeReadyCallback>(atomic_ptr_get(&ready_callback));
+        if (callback) callback(ready);
+    }
+
+    void supervise() {
+        if (!is_started()) {
+            if (!connect()) k_msleep(BRIDGE_RECONNECT_INTERVAL_MS);
+            return;
+        }
+        k_sem_take(&supervisor_wake, K_MSEC(BRIDGE_HEARTBEAT_INTERVAL_MS));
+        if (!is_started()) return;
+
+        if (atomic_cas(&router_hello, 1, 0)) {
+            link_lost();
+            // Calls sent before the restart will never be answered
+            k_mutex_lock(&channel.read_mutex, K_FOREVER);
+            channel.orphans.clear();
+            k_mutex_unlock(&channel.read_mutex);
+            return;
+        }
+
+        // Traffic proves the router is there: the heartbeat only covers a silent or lossy link
+        const bool suspect = atomic_cas(&link_suspect, 1, 0);
+        if ((suspect || channel.silent_ms() >= BRIDGE_HEARTBEAT_INTERVAL_MS) && !router_alive()) {
+            link_lost();
+        }
+    }
+
+    // Update thread, on $/hello. A bridge not started yet is connecting anyway
+    void hello() {
+        if (!is_started()) return;
+        atomic_set(&router_hello, 1);
+        k_sem_give(&supervisor_wake);
+    }
+
+    // Update thread: a dropped frame may mean the router went away, have it checked now
+    void watch_link() {
+        const atomic_val_t errors = atomic_get(&channel.link_errors);
+        if (errors == seen_link_errors) return;
+        seen_link_errors = errors;
+        atomic_set(&link_suspect, 1);
+        k_sem_give(&supervisor_wake);
+    }
+
+    // Older routers lack $/capabilities, and the oldest $/version as well
+    void load_capabilities() {
+        RouterCapabilities fetched;
+        if (call(GET_CAPABILITIES_METHOD).result(fetched)) {
+            if (fetched.protocol < ROUTER_PROTOCOL_CAPABLE) fetched.protocol = ROUTER_PROTOCOL_CAPABLE;
+        } else {
+            fetched = RouterCapabilities();
+            if (getRouterVersion(fetched.version)) {
+                fetched.protocol = ROUTER_PROTOCOL_VERSIONED;
             }
+        }
+        k_mutex_lock(&caps_mutex, K_FOREVER);
+        caps = fetched;
+        k_mutex_unlock(&caps_mutex);
+    }
+
+    // Blocks the update thread until there may be something to read. served tells whether
+    // the last pass found work: bytes it left belong to a caller waiting for a response,
+    // which wakes this thread once it took it, as does every other consumer of responses
+    void wait_rx(bool served) {
+        if (served) idle_poll_ms = BRIDGE_IDLE_POLL_MS;
 
+        if (atomic_get(&rx_events)) {
+            // pending async calls may expire without any byte coming in
+            k_sem_take(&channel.rx_sem, channel.async.pending() ? K_MSEC(BRIDGE_IDLE_POLL_MS) : K_FOREVER);
+            return;
         }
 
+        // No RX interrupt reporting: checking the UART buffer is much cheaper than a decode
+        // attempt, and the checks get rarer the longer the link stays idle
+        while (!served || serial_ptr->available() <= 0) {
+            if (k_sem_take(&channel.rx_sem, K_MSEC(idle_poll_ms)) == 0) {
+                idle_poll_ms = BRIDGE_IDLE_POLL_MS;
+                return;
+            }
+            idle_poll_ms = idle_poll_ms * 2 < BRIDGE_IDLE_POLL_MAX_MS ? idle_poll_ms * 2 : BRIDGE_IDLE_POLL_MAX_MS;
+            served = true;
+        }
+    }
+
+    bool poll_async() {
+        return channel.async.poll(*channel.client, channel.read_mutex, channel.orphans, atomic_get(&channel.link_errors));
+    }
+
+    // Main loop: runs one provide_safe request queued by the update thread. Returns at
+    // once when there is none, without taking a lock or sleeping
+    void update_safe() {
+
+        // Sketches without provide_safe methods never look at the queue
+        if (providers.safe_size() == 0) return;
+
+        uint8_t index;
+        if (k_msgq_get(&safe_queue, &index, K_NO_WAIT) != 0) return;
+
+        RPCRequest<> req;
+        memcpy(req.buffer, safe_slots[index].buffer, safe_slots[index].size);
+        req.size = safe_slots[index].size;
+
+        // The update thread may be holding a request back for lack of a slot
+        const atomic_val_t was_free = atomic_or(&safe_free, static_cast<atomic_val_t>(1UL << index));
+        if (was_free == 0) channel.wake_update();
+
+        serve(req, SERVING_SAFE);
+    }
+
+    // Update thread. Cannot fail: it is the only producer, and update() checked for a free slot
+    void queue_safe(const RPCRequest<>& req) {
+        uint8_t index = 0;
+        while (!atomic_test_and_clear_bit(&safe_free, index)) index++;
+        safe_slots[index].size = static_cast<uint16_t>(req.size);
+        memcpy(safe_slots[index].buffer, req.buffer, req.size);
+        k_msgq_put(&safe_queue, &index, K_NO_WAIT);
+    }
+
+    // Under bridge_mutex. The first provide_safe allocates the slots of its requests,
+    // or takes those reserved in the object with BRIDGE_STATIC_ALLOCATION
+    bool insert_provider(const MsgPack::str_t& name, bool safe) {
+        if (safe && !safe_slots) {
+#ifdef BRIDGE_STATIC_ALLOCATION
+            safe_slots = safe_storage;
+#else
+            safe_slots = new BridgeSafeRequest[BRIDGE_SAFE_QUEUE_SIZE];
+#endif
+            atomic_set(&safe_free, static_cast<atomic_val_t>((1ULL << BRIDGE_SAFE_QUEUE_SIZE) - 1));
+        }
+        k_mutex_lock(&providers_mutex, K_FOREVER);
+        const bool out = providers.insert(name, safe);
+        k_mutex_unlock(&providers_mutex);
+        return out;
+    }
+
+
+    void serve(RPCRequest<>& req, uint8_t mode) {
+        serving[mode] = &req;
+        server->process_request(req);
+        serving[mode] = nullptr;
+
+        // Responses jump ahead of any queued bulk traffic
+        channel.lock_in_order(RPC_PRIORITY_REALTIME);
+        server->send_response(req);
+        channel.write_lock.unlock();
     }
 
     friend class BridgeClassUpdater;
+    template<size_t> friend class BridgeStreamWriter;
+
+};
+
+// Sends a sequence of calls to the same method keeping up to Window of them in flight.
+// Each call must return the number of bytes it consumed. The writer counts the bytes of the
+// frames acknowledged in order, up to the first short or failed one: the peer got exactly
+// those. Nothing is sent after that frame
+template<size_t Window=BRIDGE_STREAM_WINDOW>
+class BridgeStreamWriter {
+
+    BridgeClass* bridge;
+    MsgPack::str_t method;
+    RpcPriority priority;
+
+    // Frames in flight, oldest first. A response may come back before an older one's
+    uint32_t pending_id[Window]{};
+    size_t pending_size[Window]{};
+    size_t pending_written[Window]{};
+    bool pending_done[Window]{};
+    bool pending_ok[Window]{};
+    size_t in_flight = 0;
+
+    size_t acked = 0;
+    bool failed = false;
+    bool abandoned = false;     // timed out, some responses still to discard
+    int64_t deadline = 0;
+
+    RpcChannel& channel() {
+        return bridge->channel;
+    }
+
+    template<typename Sender>
+    bool dispatch(size_t size, Sender&& sender) {
+
+        while (in_flight == Window && !failed) {
+            collect();
+        }
+
+        if (failed) return false;
+
+        if (in_flight == 0) touch();
+
+        uint32_t msg_id;
+        if (!channel().lock_in_order(priority, deadline)) {
+            failed = true;
+            return false;
+        }
+        const bool ok = sender(msg_id);
+        channel().write_lock.unlock();
+
+        if (!ok) {
+            failed = true;
+            return false;
+        }
+
+        pending_id[in_flight] = msg_id;
+        pending_size[in_flight] = size;
+        pending_done[in_flight] = false;
+        in_flight++;
+        return true;
+    }
+
+    void touch() {
+        const uint32_t timeout = atomic_get(&channel().default_timeout);
+        deadline = timeout > 0 ? k_uptime_get() + timeout : 0;
+    }
+
+public:
+
+    BridgeStreamWriter(BridgeClass& bridge, const MsgPack::str_t& method, RpcPriority priority=RPC_PRIORITY_BULK):
+        bridge(&bridge), method(method), priority(priority) {}
+
+    ~BridgeStreamWriter() {
+        finish();
+    }
+
+    // Sends a frame carrying size bytes. Blocks only while the window is full
+    template<typename... Args>
+    bool send(size_t size, Args&&... args) {
+        return dispatch(size, [&](uint32_t& msg_id) {
+            return channel().client->send_rpc(method, msg_id, std::forward<Args>(args)...);
+        });
+    }
+
+    // Same as send(size, head..., BinaryView(data, size)), but the payload is streamed to
+    // the link from data instead of being packed in RAM first
+    template<typename... Head>
+    bool send_view(const uint8_t* data, size_t size, const Head&... head) {
+        return dispatch(size, [&](uint32_t& msg_id) {
+            return channel().send_view(method, msg_id, data, size, head...);
+        });
+    }
+
+    // Waits for every frame in flight and returns the bytes acknowledged in order
+    size_t finish() {
+        while (in_flight > 0) {
+            collect();
+        }
+        return acked;
+    }
+
+    size_t acknowledged() const {
+        return acked;
+    }
+
+    bool isError() const {
+        return failed;
+    }
+
+private:
+
+    // Counts the frames acknowledged in order. Past a short or failed frame the peer
+    // stream has a hole: the frames after it are collected but no longer counted
+    void settle() {
+        while (in_flight > 0 && pending_done[0]) {
+            if (!failed) {
+                acked += pending_written[0];
+                if (!pending_ok[0]) failed = true;
+            }
+            in_flight--;
+            for (size_t i = 0; i < in_flight; ++i) {
+                pending_id[i] = pending_id[i + 1];
+                pending_size[i] = pending_size[i + 1];
+                pending_written[i] = pending_written[i + 1];
+                pending_done[i] = pending_done[i + 1];
+                pending_ok[i] = pending_ok[i + 1];
+            }
+        }
+    }
+
+    // Responses may come back in any order, so every pending id is polled.
+    // If none arrives within the default timeout the whole window is abandoned
+    void collect() {
+
+        if (k_mutex_lock(&channel().read_mutex, K_MSEC(10)) != 0) {
+            k_yield();
+            return;
+        }
+
+        channel().orphans.drain(*channel().client);
+
+        bool got_one = false;
+        for (size_t i = 0; i < in_flight; ++i) {
+            if (pending_done[i]) continue;
+            size_t written = 0;
+            RpcError err;
+            if (!channel().client->get_response(pending_id[i], written, err)) continue;
+
+            got_one = true;
+            touch();
+            pending_done[i] = true;
+            pending_ok[i] = err.code == NO_ERR && written >= pending_size[i];
+            pending_written[i] = err.code > NO_ERR ? 0 : (written < pending_size[i] ? written : pending_size[i]);
+            break;
+        }
+        settle();
+
+        if (!got_one && deadline > 0 && k_uptime_get() >= deadline) {
+            // frames the orphans had no room for stay in flight: finish() discards their responses
+            for (size_t i = 0; i < in_flight; ++i) {
+                if (pending_done[i] || (abandoned && channel().orphans.full())) continue;
+                if (channel().orphans.add(pending_id[i])) {
+                    pending_done[i] = true;
+                    pending_ok[i] = false;
+                    pending_written[i] = 0;
+                }
+            }
+            abandoned = true;
+            failed = true;
+            settle();
+        }
+
+        k_mutex_unlock(&channel().read_mutex);
+
+        // Requests may wait in the decoder behind the responses taken
+        channel().wake_update();
+        if (!got_one) k_msleep(1);
+    }
 
 };
 
@@ -323,23 +2068,74 @@ public:
         }
     }
 
+    static void safeUpdateAll() {
+        BridgeClass* bridge = static_cast<BridgeClass*>(atomic_ptr_get(&BridgeClass::instances));
+        for (; bridge != nullptr; bridge = bridge->next_instance) {
+            safeUpdate(bridge);
+        }
+    }
+
+    static void threadUpdate(BridgeClass* bridge) {
+        if (!(*bridge)) {
+            // Sleeps until connect() succeeds. Pending call_async still expire meanwhile
+            k_sem_take(&bridge->online, K_MSEC(BRIDGE_RECONNECT_INTERVAL_MS));
+            bridge->poll_async();
+            return;
+        }
+        bridge->wait_rx(bridge->last_pass_served);
+        // Serve everything already decoded, then go back to sleep
+        bool served = false;
+        while (bridge->update()) {
+            served = true;
+        }
+        if (bridge->poll_async()) {
+            // requests behind the responses it took are already in the decoder: no byte will
+            // come to wake the next pass
+            bridge->channel.wake_update();
+            served = true;
+        }
+        if (served) bridge->channel.heard();
+        bridge->watch_link();
+        bridge->last_pass_served = served;
+    }
+
+    static void supervise(BridgeClass* bridge) {
+        bridge->supervise();
+    }
+
+    // Sleeps until a frame is queued or a telemetry notification is due
+    static void threadWrite(BridgeClass* bridge) {
+        const int64_t due = bridge->telemetry_table.flush(bridge->channel.tx);
+        const int64_t wait = due - k_uptime_get();
+        bridge->channel.write_queued(due == 0 ? K_FOREVER : K_MSEC(wait > 0 ? wait : 0));
+    }
+
 private:
     BridgeClassUpdater() = delete; // prevents instantiation
 };
 
 inline BridgeClass Bridge(Serial1);
 
-inline void updateEntryPoint(void *, void *, void *){
+inline void updateEntryPoint(void *bridge, void *, void *){
     while (true) {
-        if (Bridge) {
-            Bridge.update();
-        }
-        k_yield();
+        BridgeClassUpdater::threadUpdate(static_cast<BridgeClass*>(bridge));
+    }
+}
+
+inline void supervisorEntryPoint(void *bridge, void *, void *){
+    while (true) {
+        BridgeClassUpdater::supervise(static_cast<BridgeClass*>(bridge));
+    }
+}
+
+inline void writerEntryPoint(void *bridge, void *, void *){
+    while (true) {
+        BridgeClassUpdater::threadWrite(static_cast<BridgeClass*>(bridge));
     }
 }
 
 static void safeUpdate(){
-    BridgeClassUpdater::safeUpdate(&Bridge);
+    BridgeClassUpdater::safeUpdateAll();
 }
 
 // leave as is
@@ -348,4 +2144,6 @@ void __attribute__((weak)) __loopHook(void){
     safeUpdate();
 }
 
+#include "bridge_coro.h"
+
 #endif // ROUTER_BRIDGE_H
\ No newline at end of file
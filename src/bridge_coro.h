@@ -0,0 +1,203 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_CORO_H
+#define BRIDGE_CORO_H
+
+#include "bridge.h"
+
+#ifdef BRIDGE_HAS_COROUTINES
+
+#include <coroutine>
+
+// Coroutines made ready by the bridge and waiting for BridgeScheduler::run. More of them
+// go to an overflow list, so the update thread never waits for run()
+#ifndef BRIDGE_TASK_QUEUE_SIZE
+#define BRIDGE_TASK_QUEUE_SIZE      16
+#endif
+
+// Resumes, in the thread calling run(), the coroutines whose bridge calls completed.
+// Many tasks then share that thread's stack instead of blocking one thread each
+class BridgeScheduler {
+
+public:
+
+    // Held by each awaitable, so that queueing a coroutine never allocates
+    struct Ready {
+        std::coroutine_handle<> task{};
+        Ready* next = nullptr;
+    };
+
+private:
+
+    struct k_msgq ready{};
+    alignas(void*) char ready_buffer[BRIDGE_TASK_QUEUE_SIZE * sizeof(void*)];
+
+    // Used once the queue is full, until run() empties it. Oldest first
+    struct k_spinlock overflow_lock{};
+    Ready* overflow_head = nullptr;
+    Ready* overflow_tail = nullptr;
+
+    Ready* take_overflow() {
+        k_spinlock_key_t key = k_spin_lock(&overflow_lock);
+        Ready* out = overflow_head;
+        if (out) {
+            overflow_head = out->next;
+            if (!overflow_head) overflow_tail = nullptr;
+        }
+        k_spin_unlock(&overflow_lock, key);
+        return out;
+    }
+
+public:
+
+    BridgeScheduler() {
+        k_msgq_init(&ready, ready_buffer, sizeof(void*), BRIDGE_TASK_QUEUE_SIZE);
+    }
+
+    BridgeScheduler(const BridgeScheduler&) = delete;
+    BridgeScheduler& operator=(const BridgeScheduler&) = delete;
+
+    // Called by the update thread, never waits. Once anything overflowed, later tasks
+    // queue behind it so that they are resumed in order
+    void schedule(Ready& node) {
+        node.next = nullptr;
+        Ready* address = &node;
+        k_spinlock_key_t key = k_spin_lock(&overflow_lock);
+        if (overflow_head || k_msgq_put(&ready, &address, K_NO_WAIT) != 0) {
+            if (overflow_tail) {
+                overflow_tail->next = &node;
+            } else {
+                overflow_head = &node;
+            }
+            overflow_tail = &node;
+        }
+        k_spin_unlock(&overflow_lock, key);
+    }
+
+    // Resumes every ready coroutine. Returns how many ran
+    size_t run() {
+        size_t resumed = 0;
+        Ready* node;
+        while (k_msgq_get(&ready, &node, K_NO_WAIT) == 0 || (node = take_overflow()) != nullptr) {
+            // the awaitable holding node may be gone once its coroutine runs
+            const std::coroutine_handle<> task = node->task;
+            task.resume();
+            resumed++;
+        }
+        return resumed;
+    }
+
+};
+
+// Default scheduler of call_co and of the wrappers' awaitables. Run it from loop()
+inline BridgeScheduler BridgeTasks;
+
+// Fire and forget coroutine: starts at once, frees itself when it returns. E.g.
+// BridgeTask poll_sensor() { auto v = co_await Bridge.call_co<float>("sensor/read"); ... }
+struct BridgeTask {
+    struct promise_type {
+        BridgeTask get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+};
+
+// What co_await of a bridge call gives back
+template<typename RType>
+struct BridgeResult {
+    RType value{};
+    RpcError error;
+
+    bool ok() const {
+        return error.code == NO_ERR;
+    }
+
+    explicit operator bool() const {
+        return ok();
+    }
+};
+
+// Bridge call sent through call_async when built. co_await suspends the coroutine until the
+// response, then BridgeScheduler::run resumes it. Neither copyable nor movable: the pending
+// completion points to it. Destroying it before completion cancels the call
+template<typename RType>
+class RpcAwaitable {
+
+    enum : atomic_val_t { CALL_PENDING, CALL_SUSPENDED, CALL_DONE };
+
+    BridgeClass* bridge;
+    BridgeScheduler* scheduler;
+    BridgeScheduler::Ready waiter{};
+    RpcAsyncCalls::Ticket ticket{};
+    atomic_t state = ATOMIC_INIT(CALL_PENDING);
+    BridgeResult<RType> outcome;
+
+public:
+
+    template<typename... Args>
+    RpcAwaitable(BridgeClass& b, BridgeScheduler& s, const MsgPack::str_t& method, Args&&... args): bridge(&b), scheduler(&s) {
+        const bool sent = b.call_async(ticket, method, [this](const RType& value, const RpcError& error) {
+            outcome.value = value;
+            outcome.error = error;
+            // suspended: nothing else touches this object until the coroutine is resumed
+            if (!atomic_cas(&state, CALL_PENDING, CALL_DONE)) {
+                scheduler->schedule(waiter);
+            }
+        }, std::forward<Args>(args)...);
+
+        if (!sent) {
+            outcome.error = RpcError(GENERIC_ERR, "The call could not be sent");
+            atomic_set(&state, CALL_DONE);
+        }
+    }
+
+    RpcAwaitable(const RpcAwaitable&) = delete;
+    RpcAwaitable& operator=(const RpcAwaitable&) = delete;
+
+    // Never awaited: the call is cancelled, and the update thread's next pass runs the
+    // callback that still points here
+    ~RpcAwaitable() {
+        if (atomic_get(&state) != CALL_PENDING) return;
+        bridge->cancel_async(ticket);
+        while (atomic_get(&state) == CALL_PENDING) {
+            k_msleep(1);
+        }
+    }
+
+    bool await_ready() const {
+        return atomic_get(&state) == CALL_DONE;
+    }
+
+    // Does not suspend if the response came in the meantime
+    bool await_suspend(std::coroutine_handle<> coroutine) {
+        waiter.task = coroutine;
+        return atomic_cas(&state, CALL_PENDING, CALL_SUSPENDED);
+    }
+
+    BridgeResult<RType> await_resume() {
+        return std::move(outcome);
+    }
+
+};
+
+template<typename RType, typename... Args>
+RpcAwaitable<RType> BridgeClass::call_co(const MsgPack::str_t& method, Args&&... args) {
+    return RpcAwaitable<RType>(*this, BridgeTasks, method, std::forward<Args>(args)...);
+}
+
+#endif // BRIDGE_HAS_COROUTINES
+
+#endif // BRIDGE_CORO_H
@@ -0,0 +1,280 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_BUFFER_POOL_H
+#define BRIDGE_BUFFER_POOL_H
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include "spsc_ring.h"
+
+// Define BRIDGE_SHARED_BUFFERS (build flag, same value in every translation unit) to have
+// Monitor, TCP and UDP borrow their RX buffers from one shared pool instead of embedding them
+//#define BRIDGE_SHARED_BUFFERS
+
+#ifndef BRIDGE_POOL_BLOCK_SIZE
+#define BRIDGE_POOL_BLOCK_SIZE      128
+#endif
+
+#ifndef BRIDGE_POOL_BLOCKS
+#define BRIDGE_POOL_BLOCKS          32
+#endif
+
+// Upper bound of setBufferLimit: blocks one buffer may hold at once
+#ifndef BRIDGE_POOL_MAX_BLOCKS_PER_BUFFER
+#define BRIDGE_POOL_MAX_BLOCKS_PER_BUFFER   16
+#endif
+
+// Fixed size blocks shared by every pooled buffer. Initialized on first use
+class BridgeBufferPool {
+
+    struct k_mem_slab slab{};
+    alignas(4) char storage[BRIDGE_POOL_BLOCKS * BRIDGE_POOL_BLOCK_SIZE];
+    atomic_t initialized = ATOMIC_INIT(0);     // 0: no, 1: in progress, 2: ready
+
+    void init() {
+        if (atomic_get(&initialized) == 2) return;
+        if (atomic_cas(&initialized, 0, 1)) {
+            k_mem_slab_init(&slab, storage, BRIDGE_POOL_BLOCK_SIZE, BRIDGE_POOL_BLOCKS);
+            atomic_set(&initialized, 2);
+            return;
+        }
+        while (atomic_get(&initialized) != 2) {
+            k_yield();
+        }
+    }
+
+public:
+
+    static_assert(BRIDGE_POOL_BLOCK_SIZE % 4 == 0, "BRIDGE_POOL_BLOCK_SIZE must be a multiple of 4");
+
+    BridgeBufferPool() = default;
+    BridgeBufferPool(const BridgeBufferPool&) = delete;
+    BridgeBufferPool& operator=(const BridgeBufferPool&) = delete;
+
+    // Never waits: nullptr when the pool is exhausted
+    uint8_t* take() {
+        init();
+        void* block = nullptr;
+        if (k_mem_slab_alloc(&slab, &block, K_NO_WAIT) != 0) return nullptr;
+        return static_cast<uint8_t*>(block);
+    }
+
+    void give(uint8_t* block) {
+        k_mem_slab_free(&slab, block);
+    }
+
+    size_t free_blocks() {
+        init();
+        return k_mem_slab_num_free_get(&slab);
+    }
+
+};
+
+inline BridgeBufferPool BridgeBuffers;
+
+// Byte FIFO made of blocks borrowed from BridgeBuffers, with the interface of SpscRingBuffer.
+// An empty buffer holds no block, so idle connections cost a few words of RAM, and a busy one
+// can be allowed more than its default size with setBufferLimit. The producer calls reserve()
+// before fetching, so that bytes it fetched always fit, and trim() after storing, to give
+// back what the fetch did not use. Consumed blocks are returned as the consumer reads.
+// A short spinlock protects the block list, taken by both sides
+template<size_t DefaultLimit>
+class PooledRingBuffer {
+
+    static constexpr size_t B = BRIDGE_POOL_BLOCK_SIZE;
+    static constexpr size_t MaxBlocks = BRIDGE_POOL_MAX_BLOCKS_PER_BUFFER;
+
+    uint8_t* blocks[MaxBlocks] = {};
+    size_t first = 0;           // slot of the oldest block in blocks[]
+    size_t count = 0;           // blocks held
+    size_t head = 0;            // read offset into the oldest block
+    size_t used = 0;            // bytes stored
+    size_t limit = DefaultLimit < MaxBlocks * B ? DefaultLimit : MaxBlocks * B;
+    mutable struct k_spinlock lock{};
+
+    static size_t smaller(size_t a, size_t b) {
+        return a < b ? a : b;
+    }
+
+    uint8_t* block(size_t i) const {
+        return blocks[(first + i) % MaxBlocks];
+    }
+
+    size_t room() const {
+        return count * B - head - used;
+    }
+
+    // Returns the blocks the consumer went past. The one holding the write position stays,
+    // it may carry room reserved by the producer: trim() gives it back once empty
+    void drop_consumed() {
+        while (count > 0 && head >= B) {
+            BridgeBuffers.give(blocks[first]);
+            blocks[first] = nullptr;
+            first = (first + 1) % MaxBlocks;
+            count--;
+            head -= B;
+        }
+    }
+
+public:
+
+    PooledRingBuffer() = default;
+
+    // A copy starts empty with the same limit: blocks are never shared between two buffers
+    PooledRingBuffer(const PooledRingBuffer& other): limit(other.limit) {}
+
+    PooledRingBuffer& operator=(const PooledRingBuffer& other) {
+        if (this != &other) {
+            clear();
+            trim();
+            limit = other.limit;
+        }
+        return *this;
+    }
+
+    ~PooledRingBuffer() {
+        for (size_t i = 0; i < count; i++) {
+            BridgeBuffers.give(block(i));
+        }
+    }
+
+    // Most bytes this buffer may hold, rounded to what fits in its blocks
+    void setLimit(size_t bytes) {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        limit = smaller(bytes, MaxBlocks * B);
+        k_spin_unlock(&lock, key);
+    }
+
+    size_t getLimit() const {
+        return limit;
+    }
+
+    int available() const {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        const size_t n = used;
+        k_spin_unlock(&lock, key);
+        return (int)n;
+    }
+
+    // Bytes allowed by the limit. The pool may have less: see reserve()
+    int availableForStore() const {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        const size_t n = limit > used ? limit - used : 0;
+        k_spin_unlock(&lock, key);
+        return (int)n;
+    }
+
+    bool isFull() const {
+        return availableForStore() == 0;
+    }
+
+    // Producer side: borrows blocks for up to size more bytes and returns how many are
+    // guaranteed to fit in the next store
+    size_t reserve(size_t size) {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        const size_t want = smaller(size, limit > used ? limit - used : 0);
+        while (room() < want && count < MaxBlocks) {
+            uint8_t* b = BridgeBuffers.take();
+            if (b == nullptr) break;
+            blocks[(first + count) % MaxBlocks] = b;
+            count++;
+        }
+        const size_t n = smaller(want, room());
+        k_spin_unlock(&lock, key);
+        return n;
+    }
+
+    // Producer side: returns the blocks reserve() took and nothing was stored in
+    void trim() {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        if (used == 0) head = 0;
+        while (count > 0 && (count - 1) * B >= head + used) {
+            count--;
+            const size_t slot = (first + count) % MaxBlocks;
+            BridgeBuffers.give(blocks[slot]);
+            blocks[slot] = nullptr;
+        }
+        k_spin_unlock(&lock, key);
+    }
+
+    void store_char(uint8_t c) {
+        store(&c, 1);
+    }
+
+    // Producer side bulk copy into reserved room, returns the number of bytes actually stored
+    size_t store(const uint8_t* data, size_t size) {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        const size_t n = smaller(size, room());
+        size_t pos = head + used;
+        for (size_t done = 0; done < n; ) {
+            const size_t chunk = smaller(n - done, B - pos % B);
+            memcpy(block(pos / B) + pos % B, data + done, chunk);
+            done += chunk;
+            pos += chunk;
+        }
+        used += n;
+        k_spin_unlock(&lock, key);
+        return n;
+    }
+
+    int read_char() {
+        uint8_t c;
+        return read(&c, 1) ? c : -1;
+    }
+
+    // Consumer side bulk copy, returns the number of bytes actually read
+    size_t read(uint8_t* data, size_t size) {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        const size_t n = smaller(size, used);
+        for (size_t done = 0; done < n; ) {
+            const size_t chunk = smaller(n - done, B - head);
+            memcpy(data + done, blocks[first] + head, chunk);
+            done += chunk;
+            head += chunk;
+            used -= chunk;
+            drop_consumed();
+        }
+        k_spin_unlock(&lock, key);
+        return n;
+    }
+
+    int peek() const {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        const int c = used ? blocks[first][head] : -1;
+        k_spin_unlock(&lock, key);
+        return c;
+    }
+
+    // Consumer side: drops everything stored so far
+    void clear() {
+        k_spinlock_key_t key = k_spin_lock(&lock);
+        head += used;
+        used = 0;
+        drop_consumed();
+        k_spin_unlock(&lock, key);
+    }
+
+};
+
+// RX buffer of the Monitor, TCP and UDP wrappers
+#ifdef BRIDGE_SHARED_BUFFERS
+template<size_t N>
+using BridgeRxBuffer = PooledRingBuffer<N>;
+#else
+template<size_t N>
+using BridgeRxBuffer = SpscRingBuffer<N>;
+#endif
+
+#endif // BRIDGE_BUFFER_POOL_H
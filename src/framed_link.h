@@ -0,0 +1,188 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_FRAMED_LINK_H
+#define BRIDGE_FRAMED_LINK_H
+
+#include <string.h>
+#include <Arduino.h>
+#include <zephyr/sys/atomic.h>
+#include <Arduino_RPClite.h>
+
+// Define BRIDGE_FRAMED_LINK (build flag, same value in every translation unit, and a router
+// speaking the same framing) to carry every message in a checked frame:
+// A5 5A | len lo | len hi | len lo ^ len hi ^ 55 | payload | CRC-16/CCITT-FALSE of len and payload, big endian
+//#define BRIDGE_FRAMED_LINK
+
+#define BRIDGE_FRAME_SYNC0      0xA5
+#define BRIDGE_FRAME_SYNC1      0x5A
+#define BRIDGE_FRAME_HEADER     5
+#define BRIDGE_FRAME_TRAILER    2
+
+// Largest payload accepted from the router. Longer frames are treated as corrupted
+#ifndef BRIDGE_LINK_FRAME_MAX
+#define BRIDGE_LINK_FRAME_MAX   1024
+#endif
+
+inline uint16_t bridge_crc16(uint16_t crc, const uint8_t* data, size_t size) {
+    while (size--) {
+        crc ^= static_cast<uint16_t>(*data++) << 8;
+        for (uint8_t bit = 0; bit < 8; bit++) {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+    return crc;
+}
+
+// ITransport carrying one message per frame. A frame failing its checks is dropped and the
+// receiver looks for the next sync marker inside the bytes it already has, so a line glitch
+// costs the messages it hit and nothing after them. Each dropped frame increments errors.
+// Writes: each write() is a frame, unless begin_frame() opened one that spans several
+class BridgeFramedTransport : public ITransport {
+
+    Stream& stream;
+    atomic_t* errors;
+
+    size_t tx_remaining = 0;
+    uint16_t tx_crc = 0;
+
+    uint8_t raw[BRIDGE_FRAME_HEADER + BRIDGE_LINK_FRAME_MAX + BRIDGE_FRAME_TRAILER];
+    size_t raw_len = 0;         // bytes of the frame being received
+    size_t rx_pos = 0;          // payload of the last good frame not read yet: raw[rx_pos, rx_len)
+    size_t rx_len = 0;
+
+    // bad: no sync marker, line noise. corrupt: a frame was there and got lost, counted
+    enum Check { FRAME_PARTIAL, FRAME_GOOD, FRAME_BAD, FRAME_CORRUPT };
+
+    size_t payload_size() const {
+        return raw[2] | (static_cast<size_t>(raw[3]) << 8);
+    }
+
+    Check check() const {
+        if (raw_len >= 1 && raw[0] != BRIDGE_FRAME_SYNC0) return FRAME_BAD;
+        if (raw_len >= 2 && raw[1] != BRIDGE_FRAME_SYNC1) return FRAME_BAD;
+        if (raw_len < BRIDGE_FRAME_HEADER) return FRAME_PARTIAL;
+        if (raw[4] != (raw[2] ^ raw[3] ^ 0x55) || payload_size() > BRIDGE_LINK_FRAME_MAX) return FRAME_CORRUPT;
+
+        const size_t size = payload_size();
+        if (raw_len < BRIDGE_FRAME_HEADER + size + BRIDGE_FRAME_TRAILER) return FRAME_PARTIAL;
+
+        const uint16_t crc = bridge_crc16(bridge_crc16(0xFFFF, raw + 2, 2), raw + BRIDGE_FRAME_HEADER, size);
+        const uint8_t* trailer = raw + BRIDGE_FRAME_HEADER + size;
+        return trailer[0] == (crc >> 8) && trailer[1] == (crc & 0xFF) ? FRAME_GOOD : FRAME_CORRUPT;
+    }
+
+    // Drops the first byte and everything up to the next sync candidate
+    void resync() {
+        size_t skip = 1;
+        while (skip < raw_len && raw[skip] != BRIDGE_FRAME_SYNC0) skip++;
+        memmove(raw, raw + skip, raw_len - skip);
+        raw_len -= skip;
+    }
+
+    // Reads from the port until a good frame is in raw. False when the port ran dry first
+    bool receive() {
+        while (true) {
+            const Check state = check();
+            if (state == FRAME_GOOD) {
+                rx_pos = BRIDGE_FRAME_HEADER;
+                rx_len = BRIDGE_FRAME_HEADER + payload_size();
+                return true;
+            }
+            if (state != FRAME_PARTIAL) {
+                if (state == FRAME_CORRUPT) atomic_inc(errors);
+                resync();
+                continue;
+            }
+            const int c = stream.read();
+            if (c < 0) return false;
+            raw[raw_len++] = static_cast<uint8_t>(c);
+        }
+    }
+
+    bool payload_ready() {
+        if (rx_pos < rx_len) return true;
+        if (rx_len > 0) {
+            // the delivered frame is consumed. Bytes after it, kept by a resync, come next
+            const size_t end = rx_len + BRIDGE_FRAME_TRAILER;
+            memmove(raw, raw + end, raw_len - end);
+            raw_len -= end;
+            rx_pos = rx_len = 0;
+        }
+        return receive();
+    }
+
+    void send_header(size_t size) {
+        const uint8_t header[BRIDGE_FRAME_HEADER] = {
+            BRIDGE_FRAME_SYNC0, BRIDGE_FRAME_SYNC1,
+            static_cast<uint8_t>(size), static_cast<uint8_t>(size >> 8),
+            static_cast<uint8_t>(static_cast<uint8_t>(size) ^ static_cast<uint8_t>(size >> 8) ^ 0x55)
+        };
+        stream.write(header, sizeof(header));
+        tx_crc = bridge_crc16(0xFFFF, header + 2, 2);
+        tx_remaining = size;
+    }
+
+public:
+
+    BridgeFramedTransport(Stream& s, atomic_t* link_errors): stream(s), errors(link_errors) {}
+
+    // The next writes, size bytes in total, form a single frame.
+    // Must be used holding the write lock, up to the last of those writes
+    void begin_frame(size_t size) {
+        send_header(size);
+    }
+
+    size_t write(const uint8_t* data, size_t size) override {
+        size_t written = 0;
+        while (written < size) {
+            if (tx_remaining == 0) {
+                send_header(size - written < 0xFFFF ? size - written : 0xFFFF);
+            }
+            const size_t n = size - written < tx_remaining ? size - written : tx_remaining;
+            stream.write(data + written, n);
+            tx_crc = bridge_crc16(tx_crc, data + written, n);
+            tx_remaining -= n;
+            written += n;
+            if (tx_remaining == 0) {
+                const uint8_t trailer[BRIDGE_FRAME_TRAILER] = {
+                    static_cast<uint8_t>(tx_crc >> 8), static_cast<uint8_t>(tx_crc)
+                };
+                stream.write(trailer, sizeof(trailer));
+            }
+        }
+        return written;
+    }
+
+    size_t read(uint8_t* buffer, size_t size) override {
+        size_t n = 0;
+        while (n < size && payload_ready()) {
+            const size_t chunk = size - n < rx_len - rx_pos ? size - n : rx_len - rx_pos;
+            memcpy(buffer + n, raw + rx_pos, chunk);
+            rx_pos += chunk;
+            n += chunk;
+        }
+        return n;
+    }
+
+    size_t read_byte(uint8_t& r) override {
+        return read(&r, 1);
+    }
+
+    bool available() override {
+        return payload_ready();
+    }
+
+};
+
+#endif // BRIDGE_FRAMED_LINK_H
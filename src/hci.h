@@ -24,25 +24,10 @@
 #define HCI_AVAIL_METHOD    "hci/avail"
 #define HCI_BUFFER_SIZE     1024    // Matches Linux kernel HCI_MAX_ACL_SIZE (1024 bytes)
 
-// Lightweight binary view to avoid dynamic allocation during serialization
-struct BinaryView {
-    const uint8_t *data;
-    size_t size;
-
-    BinaryView(const uint8_t *d, size_t s) : data(d), size(s) {
-
-    }
-
-    // MsgPack serialization support
-    void to_msgpack(MsgPack::Packer &packer) const {
-        packer.pack(data, size);
-    }
-};
-
 template<size_t BufferSize=HCI_BUFFER_SIZE> class BridgeHCI {
     BridgeClass *bridge;
     struct k_mutex hci_mutex;
-    bool initialized = false;
+    atomic_t initialized = ATOMIC_INIT(0);
     MsgPack::bin_t<uint8_t> recv_buffer;
 
 public:
@@ -64,7 +49,7 @@ public:
 
         bool result;
         if (bridge->call(HCI_OPEN_METHOD, String(device)).result(result)) {
-            initialized = result;
+            atomic_set(&initialized, result);
         }
 
         k_mutex_unlock(&hci_mutex);
@@ -74,36 +59,33 @@ public:
     void end() {
         k_mutex_lock(&hci_mutex, K_FOREVER);
 
-        if (!initialized) {
+        if (!atomic_get(&initialized)) {
             k_mutex_unlock(&hci_mutex);
             return;
         }
 
         bool result;
         bridge->call(HCI_CLOSE_METHOD).result(result);
-        initialized = false;
+        atomic_set(&initialized, 0);
 
         k_mutex_unlock(&hci_mutex);
     }
 
     explicit operator bool() const {
-        k_mutex_lock(&hci_mutex, K_FOREVER);
-        bool out = initialized;
-        k_mutex_unlock(&hci_mutex);
-        return out;
+        return atomic_get(&initialized);
     }
 
     int send(const uint8_t *buffer, size_t size) {
         k_mutex_lock(&hci_mutex, K_FOREVER);
 
-        if (!initialized) {
+        if (!atomic_get(&initialized)) {
             k_mutex_unlock(&hci_mutex);
             return -1;
         }
 
         BinaryView send_buffer(buffer, size);
         size_t bytes_sent;
-        const bool ret = bridge->call(HCI_SEND_METHOD, send_buffer).result(bytes_sent);
+        const bool ret = bridge->call_priority(RPC_PRIORITY_REALTIME, HCI_SEND_METHOD, send_buffer).result(bytes_sent);
 
         k_mutex_unlock(&hci_mutex);
 
@@ -116,13 +98,13 @@ public:
     int recv(uint8_t *buffer, size_t max_size) {
         k_mutex_lock(&hci_mutex, K_FOREVER);
 
-        if (!initialized) {
+        if (!atomic_get(&initialized)) {
             k_mutex_unlock(&hci_mutex);
             return -1;
         }
 
         recv_buffer.clear();
-        bool ret = bridge->call(HCI_RECV_METHOD, max_size).result(recv_buffer);
+        bool ret = bridge->call_priority(RPC_PRIORITY_REALTIME, HCI_RECV_METHOD, max_size).result(recv_buffer);
 
         if (ret) {
             size_t bytes_to_copy = recv_buffer.size() < max_size ? recv_buffer.size() : max_size;
@@ -142,13 +124,13 @@ public:
 
         k_mutex_lock(&hci_mutex, K_FOREVER);
 
-        if (!initialized) {
+        if (!atomic_get(&initialized)) {
             k_mutex_unlock(&hci_mutex);
             return 0;
         }
 
         bool result;
-        bool ret = bridge->call(HCI_AVAIL_METHOD).result(result);
+        bool ret = bridge->call_priority(RPC_PRIORITY_REALTIME, HCI_AVAIL_METHOD).result(result);
 
         k_mutex_unlock(&hci_mutex);
 
@@ -14,8 +14,8 @@
 #ifndef BRIDGE_MONITOR_H
 #define BRIDGE_MONITOR_H
 
-#include <api/RingBuffer.h>
 #include "bridge.h"
+#include "buffer_pool.h"
 
 #define MON_CONNECTED_METHOD    "mon/connected"
 #define MON_RESET_METHOD        "mon/reset"
@@ -28,10 +28,10 @@ template<size_t BufferSize=DEFAULT_MONITOR_BUF_SIZE>
 class BridgeMonitor: public Stream {
 
     BridgeClass* bridge;
-    RingBufferN<BufferSize> temp_buffer;
+    BridgeRxBuffer<BufferSize> temp_buffer;
     struct k_mutex monitor_mutex{};
-    bool _connected = false;
-    bool _compatibility_mode = true;
+    atomic_t _connected = ATOMIC_INIT(0);
+    atomic_t _compatibility_mode = ATOMIC_INIT(1);
 
 public:
     explicit BridgeMonitor(BridgeClass& bridge): bridge(&bridge) {}
@@ -59,18 +59,14 @@ public:
         }
 
         bool out = false;
-        _connected = bridge->call(MON_CONNECTED_METHOD).result(out) && out;
-        MsgPack::str_t ver;
-        _compatibility_mode = !bridge->getRouterVersion(ver);
+        atomic_set(&_connected, bridge->call(MON_CONNECTED_METHOD).result(out) && out);
+        atomic_set(&_compatibility_mode, bridge->capability(&RouterCapabilities::protocol) == ROUTER_PROTOCOL_LEGACY);
         k_mutex_unlock(&monitor_mutex);
         return out;
     }
 
-    bool is_connected() {
-        k_mutex_lock(&monitor_mutex, K_FOREVER);
-        bool out = _connected;
-        k_mutex_unlock(&monitor_mutex);
-        return out;
+    bool is_connected() const {
+        return atomic_get(&_connected);
     }
 
     explicit operator bool() {
@@ -85,33 +81,30 @@ public:
         return cch_read? c : -1;
     }
 
+    // Lock-free: only the fetch in available() talks to the router
     int read(uint8_t* buffer, size_t size) {
-        k_mutex_lock(&monitor_mutex, K_FOREVER);
-        size_t i = 0;
-        while (temp_buffer.available() && i < size) {
-            buffer[i++] = temp_buffer.read_char();
-        }
-        k_mutex_unlock(&monitor_mutex);
-        return (int)i;
+        return (int)temp_buffer.read(buffer, size);
     }
 
     int available() override {
         k_mutex_lock(&monitor_mutex, K_FOREVER);
-        int size = temp_buffer.availableForStore();
+        int size = (int)temp_buffer.reserve(temp_buffer.availableForStore());
         if (size > 0) _read(size);
+        temp_buffer.trim();
         int available = temp_buffer.available();
         k_mutex_unlock(&monitor_mutex);
         return available;
     }
 
+#ifdef BRIDGE_SHARED_BUFFERS
+    // Lets this buffer borrow up to bytes from the shared pool (BufferSize by default)
+    void setBufferLimit(size_t bytes) {
+        temp_buffer.setLimit(bytes);
+    }
+#endif
+
     int peek() override {
-        k_mutex_lock(&monitor_mutex, K_FOREVER);
-        int out = -1;
-        if (temp_buffer.available()) {
-            out = temp_buffer.peek();
-        }
-        k_mutex_unlock(&monitor_mutex);
-        return out;
+        return temp_buffer.peek();
     }
 
     size_t write(uint8_t c) override {
@@ -128,7 +121,7 @@ public:
 
         size_t written = 0;
 
-        if (_compatibility_mode) {
+        if (atomic_get(&_compatibility_mode)) {
             bridge->call(MON_WRITE_METHOD, send_buffer).result(written);
         } else {
             bridge->notify(MON_WRITE_METHOD, send_buffer);
@@ -142,7 +135,7 @@ public:
         k_mutex_lock(&monitor_mutex, K_FOREVER);
         bool res;
         bool ok = bridge->call(MON_RESET_METHOD).result(res) && res;
-        _connected = !ok;
+        atomic_set(&_connected, !ok);
         k_mutex_unlock(&monitor_mutex);
         return ok;
     }
@@ -154,7 +147,7 @@ private:
 
         k_mutex_lock(&monitor_mutex, K_FOREVER);
 
-        if (!_connected) {
+        if (!atomic_get(&_connected)) {
             k_mutex_unlock(&monitor_mutex);
             return;
         }
@@ -164,9 +157,7 @@ private:
         const bool ret = async_rpc.result(message);
 
         if (ret) {
-            for (size_t i = 0; i < message.size(); ++i) {
-                temp_buffer.store_char(static_cast<char>(message[i]));
-            }
+            temp_buffer.store(message.data(), message.size());
         }
 
         // if (async_rpc.getErrorCode() > NO_ERR) {
@@ -0,0 +1,135 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_POLL_SET_H
+#define BRIDGE_POLL_SET_H
+
+#include <Arduino_RPClite.h>
+#include <type_traits>
+#include "splice.h"
+
+#define POLL_METHOD                 "conn/poll"
+
+// Interests, and events in the answer
+#define POLL_READ                   0x01    // bytes (or a packet, or a pending accept) to read
+#define POLL_WRITE                  0x02    // room to write
+#define POLL_CLOSED                 0x04    // closed by the peer. Always reported
+#define POLL_INVALID                0x08    // unknown id. Always reported
+
+// Id of the Monitor in a poll set
+#define POLL_MONITOR_ID             SPLICE_MONITOR_ID
+
+// Connections one BridgePollSet holds by default
+#ifndef BRIDGE_POLL_MAX
+#define BRIDGE_POLL_MAX             8
+#endif
+
+// Router answer for one connection
+struct BridgePollStatus {
+    uint8_t events = 0;
+    uint32_t available = 0;     // bytes readable right away, when the router knows
+
+    MSGPACK_DEFINE(events, available); // -> [events, available]
+};
+
+// Connections whose readiness BridgeClass::poll asks for in a single call. E.g.
+// BridgePollSet<> set; int c = set.add(client); int m = set.add(POLL_MONITOR_ID);
+// if (Bridge.poll(set, 50) > 0 && set.readable(c)) { ... client.read() ... }
+// Bytes already buffered by a wrapper are not seen by the router: read until available()
+// returns 0 before polling again
+template<size_t N=BRIDGE_POLL_MAX>
+class BridgePollSet {
+
+    uint32_t ids[N]{};
+    uint8_t interests[N]{};
+    BridgePollStatus status[N]{};
+    size_t count = 0;
+
+public:
+
+    // Packed as [[id, interests], ...] without copying the set
+    struct Request {
+        const BridgePollSet* set;
+
+        void to_msgpack(MsgPack::Packer& packer) const {
+            packer.packArraySize(set->count);
+            for (size_t i = 0; i < set->count; ++i) {
+                packer.packArraySize(2);
+                packer.pack(set->ids[i]);
+                packer.pack(set->interests[i]);
+            }
+        }
+    };
+
+    // Index of the entry in the answer, -1 when the set is full
+    int add(uint32_t id, uint8_t interest=POLL_READ) {
+        if (count >= N) return -1;
+        ids[count] = id;
+        interests[count] = interest;
+        status[count] = BridgePollStatus{};
+        return static_cast<int>(count++);
+    }
+
+    // Any wrapper with getId(): BridgeTCPClient, BridgeUDP
+    template<typename Connection, typename std::enable_if<!std::is_arithmetic<Connection>::value, int>::type = 0>
+    int add(Connection& connection, uint8_t interest=POLL_READ) {
+        return add(connection.getId(), interest);
+    }
+
+    void clear() {
+        count = 0;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    Request request() const {
+        return Request{this};
+    }
+
+    // Takes the router answer, one status per entry in order. Returns how many entries
+    // have an event they asked for, closed or invalid ones included; -1 on a malformed answer
+    int update(const MsgPack::arr_t<BridgePollStatus>& answer) {
+        if (answer.size() != count) return -1;
+        int ready = 0;
+        for (size_t i = 0; i < count; ++i) {
+            status[i] = answer[i];
+            if (status[i].events & (interests[i] | POLL_CLOSED | POLL_INVALID)) ready++;
+        }
+        return ready;
+    }
+
+    uint8_t events(int i) const {
+        return status[i].events;
+    }
+
+    bool readable(int i) const {
+        return status[i].events & POLL_READ;
+    }
+
+    bool writable(int i) const {
+        return status[i].events & POLL_WRITE;
+    }
+
+    bool closed(int i) const {
+        return status[i].events & (POLL_CLOSED | POLL_INVALID);
+    }
+
+    uint32_t available(int i) const {
+        return status[i].available;
+    }
+
+};
+
+#endif // BRIDGE_POLL_SET_H
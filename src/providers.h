@@ -0,0 +1,94 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_PROVIDERS_H
+#define BRIDGE_PROVIDERS_H
+
+#include <zephyr/sys/atomic.h>
+#include <Arduino_RPClite.h>
+
+// With BRIDGE_STATIC_ALLOCATION the provided methods are kept in a fixed table of this size,
+// and providing more fails. Otherwise the list grows with them
+#ifndef BRIDGE_MAX_PROVIDERS
+#define BRIDGE_MAX_PROVIDERS        32
+#endif
+
+struct BridgeProvidedMethod {
+    MsgPack::str_t name;
+    bool safe = false;
+};
+
+// Names provided by a bridge, replayed to a restarted router and checked for duplicates.
+// Requests are dispatched by RPCServer from its own table: this one is never looked up
+// on the request path
+class BridgeProviders {
+
+#ifdef BRIDGE_STATIC_ALLOCATION
+    BridgeProvidedMethod methods[BRIDGE_MAX_PROVIDERS];
+#else
+    MsgPack::arr_t<BridgeProvidedMethod> methods;
+#endif
+    size_t count = 0;
+    atomic_t safe_count = ATOMIC_INIT(0);   // read by the update thread without a lock
+
+public:
+
+    bool contains(const MsgPack::str_t& name) const {
+        for (size_t i = 0; i < count; ++i) {
+            if (methods[i].name == name) return true;
+        }
+        return false;
+    }
+
+    // Whether n more methods can be added
+    bool fits(size_t n) const {
+#ifdef BRIDGE_STATIC_ALLOCATION
+        return count + n <= BRIDGE_MAX_PROVIDERS;
+#else
+        (void)n;
+        return true;
+#endif
+    }
+
+    // Fails if the name is already there or the table is full
+    bool insert(const MsgPack::str_t& name, bool safe) {
+        if (!fits(1) || contains(name)) return false;
+#ifdef BRIDGE_STATIC_ALLOCATION
+        methods[count].name = name;
+        methods[count].safe = safe;
+#else
+        methods.push_back({name, safe});
+#endif
+        count++;
+        if (safe) atomic_inc(&safe_count);
+        return true;
+    }
+
+    size_t size() const {
+        return count;
+    }
+
+    size_t safe_size() const {
+        return atomic_get(&safe_count);
+    }
+
+    template<typename F>
+    void for_each(F&& f) const {
+        for (size_t i = 0; i < count; ++i) {
+            f(methods[i]);
+        }
+    }
+
+};
+
+#endif // BRIDGE_PROVIDERS_H
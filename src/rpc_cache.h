@@ -0,0 +1,142 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_RPC_CACHE_H
+#define BRIDGE_RPC_CACHE_H
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <Arduino_RPClite.h>
+
+#ifndef BRIDGE_CACHE_ENTRIES
+#define BRIDGE_CACHE_ENTRIES        4
+#endif
+
+// Calls whose encoded method+args or result exceed these sizes are not cached
+#ifndef BRIDGE_CACHE_KEY_SIZE
+#define BRIDGE_CACHE_KEY_SIZE       48
+#endif
+
+#ifndef BRIDGE_CACHE_VALUE_SIZE
+#define BRIDGE_CACHE_VALUE_SIZE     64
+#endif
+
+// Fixed-size store of msgpack encoded results, keyed by the encoded method and arguments.
+// No heap is used: the whole cache is reserved up front
+template<size_t Entries=BRIDGE_CACHE_ENTRIES, size_t KeySize=BRIDGE_CACHE_KEY_SIZE, size_t ValueSize=BRIDGE_CACHE_VALUE_SIZE>
+class RpcResultCache {
+
+    static_assert(Entries > 0, "RpcResultCache needs at least one entry");
+
+    struct Entry {
+        uint32_t hash;
+        int64_t expires;        // 0 marks a free entry
+        uint16_t key_size;
+        uint16_t value_size;
+        uint8_t key[KeySize];
+        uint8_t value[ValueSize];
+    };
+
+    Entry entries[Entries]{};
+    struct k_mutex cache_mutex{};
+
+    // FNV-1a
+    static uint32_t hash_of(const uint8_t* data, size_t size) {
+        uint32_t h = 2166136261u;
+        for (size_t i = 0; i < size; ++i) {
+            h ^= data[i];
+            h *= 16777619u;
+        }
+        return h;
+    }
+
+    Entry* find(uint32_t h, const uint8_t* key, size_t key_size, int64_t now) {
+        for (size_t i = 0; i < Entries; ++i) {
+            Entry& e = entries[i];
+            if (e.expires == 0) continue;
+            if (e.expires <= now) {
+                e.expires = 0;
+                continue;
+            }
+            if (e.hash == h && e.key_size == key_size && memcmp(e.key, key, key_size) == 0) {
+                return &e;
+            }
+        }
+        return nullptr;
+    }
+
+public:
+
+    void init() {
+        k_mutex_init(&cache_mutex);
+    }
+
+    static bool fits(size_t key_size, size_t value_size) {
+        return key_size <= KeySize && value_size <= ValueSize;
+    }
+
+    // Decodes a live entry into result. Returns false on miss
+    template<typename RType>
+    bool get(const MsgPack::Packer& key, RType& result) {
+        if (!fits(key.size(), 0)) return false;
+
+        k_mutex_lock(&cache_mutex, K_FOREVER);
+        const Entry* e = find(hash_of(key.data(), key.size()), key.data(), key.size(), k_uptime_get());
+        bool hit = false;
+        if (e) {
+            MsgPack::Unpacker unpacker;
+            hit = unpacker.feed(e->value, e->value_size) && unpacker.deserialize(result);
+        }
+        k_mutex_unlock(&cache_mutex);
+        return hit;
+    }
+
+    // Stores the encoded result, replacing the same key or the entry closest to expiry
+    void put(const MsgPack::Packer& key, const MsgPack::Packer& value, uint32_t ttl_ms) {
+        if (ttl_ms == 0 || !fits(key.size(), value.size())) return;
+
+        k_mutex_lock(&cache_mutex, K_FOREVER);
+        const int64_t now = k_uptime_get();
+        const uint32_t h = hash_of(key.data(), key.size());
+
+        Entry* e = find(h, key.data(), key.size(), now);
+        for (size_t i = 0; !e && i < Entries; ++i) {
+            if (entries[i].expires == 0) e = &entries[i];
+        }
+        if (!e) {
+            e = &entries[0];
+            for (size_t i = 1; i < Entries; ++i) {
+                if (entries[i].expires < e->expires) e = &entries[i];
+            }
+        }
+
+        e->hash = h;
+        e->expires = now + ttl_ms;
+        e->key_size = key.size();
+        e->value_size = value.size();
+        memcpy(e->key, key.data(), key.size());
+        memcpy(e->value, value.data(), value.size());
+        k_mutex_unlock(&cache_mutex);
+    }
+
+    void clear() {
+        k_mutex_lock(&cache_mutex, K_FOREVER);
+        for (size_t i = 0; i < Entries; ++i) {
+            entries[i].expires = 0;
+        }
+        k_mutex_unlock(&cache_mutex);
+    }
+
+};
+
+#endif // BRIDGE_RPC_CACHE_H
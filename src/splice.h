@@ -0,0 +1,40 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_SPLICE_H
+#define BRIDGE_SPLICE_H
+
+#include <Arduino_RPClite.h>
+
+#define SPLICE_START_METHOD         "splice/start"
+#define SPLICE_STATS_METHOD         "splice/stats"
+#define SPLICE_STOP_METHOD          "splice/stop"
+
+// splice options
+#define SPLICE_OPT_NONE             0x00
+#define SPLICE_OPT_BIDIRECTIONAL    0x01    // also forward from destination to source
+#define SPLICE_OPT_CLOSE_ON_EOF     0x02    // close both ends when either one closes
+
+// Endpoint id of the Monitor, usable as splice source or destination
+#define SPLICE_MONITOR_ID           0xFFFFFFFF
+
+// Byte counters of a router-side splice
+struct BridgeSpliceStats {
+    bool active = false;
+    uint64_t forwarded = 0;     // source to destination
+    uint64_t returned = 0;      // destination to source, bidirectional splices only
+
+    MSGPACK_DEFINE(active, forwarded, returned);
+};
+
+#endif // BRIDGE_SPLICE_H
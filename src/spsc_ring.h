@@ -0,0 +1,123 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_SPSC_RING_H
+#define BRIDGE_SPSC_RING_H
+
+#include <string.h>
+#include <zephyr/sys/atomic.h>
+
+// Lock-free single-producer/single-consumer byte ring.
+// Drop-in for RingBufferN: the producer only calls store_char/store/availableForStore,
+// the consumer everything else. Indices run over [0, 2 * N) to tell full from empty
+template<size_t N>
+class SpscRingBuffer {
+
+    static_assert(N > 0, "SpscRingBuffer size must be greater than 0");
+
+    uint8_t buffer[N];
+    atomic_t head = ATOMIC_INIT(0);     // written by the producer only
+    atomic_t tail = ATOMIC_INIT(0);     // written by the consumer only
+
+    static size_t advance(size_t index, size_t n) {
+        index += n;
+        return index >= 2 * N ? index - 2 * N : index;
+    }
+
+    static size_t slot(size_t index) {
+        return index >= N ? index - N : index;
+    }
+
+    static size_t smaller(size_t a, size_t b) {
+        return a < b ? a : b;
+    }
+
+    static size_t used(size_t h, size_t t) {
+        return h >= t ? h - t : h + 2 * N - t;
+    }
+
+public:
+
+    int available() const {
+        return (int)used(atomic_get(&head), atomic_get(&tail));
+    }
+
+    int availableForStore() const {
+        return (int)(N - used(atomic_get(&head), atomic_get(&tail)));
+    }
+
+    bool isFull() const {
+        return availableForStore() == 0;
+    }
+
+    // Producer side: the room is all there, so the next store always takes size bytes
+    size_t reserve(size_t size) const {
+        return smaller(size, (size_t)availableForStore());
+    }
+
+    // Producer side: nothing borrowed to give back
+    void trim() {}
+
+    void store_char(uint8_t c) {
+        store(&c, 1);
+    }
+
+    // Producer side bulk copy, returns the number of bytes actually stored
+    size_t store(const uint8_t* data, size_t size) {
+        const size_t h = atomic_get(&head);
+        const size_t t = atomic_get(&tail);
+        const size_t n = smaller(size, N - used(h, t));
+        if (n == 0) return 0;
+
+        const size_t first = smaller(n, N - slot(h));
+        memcpy(&buffer[slot(h)], data, first);
+        memcpy(&buffer[0], data + first, n - first);
+
+        atomic_set(&head, advance(h, n));
+        return n;
+    }
+
+    int read_char() {
+        uint8_t c;
+        return read(&c, 1) ? c : -1;
+    }
+
+    // Consumer side bulk copy, returns the number of bytes actually read
+    size_t read(uint8_t* data, size_t size) {
+        const size_t t = atomic_get(&tail);
+        const size_t h = atomic_get(&head);
+        const size_t n = smaller(size, used(h, t));
+        if (n == 0) return 0;
+
+        const size_t first = smaller(n, N - slot(t));
+        memcpy(data, &buffer[slot(t)], first);
+        memcpy(data + first, &buffer[0], n - first);
+
+        atomic_set(&tail, advance(t, n));
+        return n;
+    }
+
+    int peek() const {
+        const size_t t = atomic_get(&tail);
+        if (used(atomic_get(&head), t) == 0) return -1;
+        return buffer[slot(t)];
+    }
+
+    // Consumer side: drops everything stored so far
+    void clear() {
+        atomic_set(&tail, atomic_get(&head));
+    }
+
+};
+
+#endif // BRIDGE_SPSC_RING_H
@@ -19,10 +19,16 @@
 #define TCP_CLOSE_METHOD            "tcp/close"
 #define TCP_WRITE_METHOD            "tcp/write"
 #define TCP_READ_METHOD             "tcp/read"
+#define TCP_CONNECT_SSL_CA_METHOD   "tcp/connectSSLWithCA"
+
+// connectSSL options, honoured by the router when connecting with a registered CA
+#define TLS_OPT_NONE                0x00
+#define TLS_OPT_RESUME_SESSION      0x01    // reuse a cached TLS session for the same host:port
+#define TLS_OPT_KEEP_ALIVE          0x02    // park the connection on stop() and hand it back on the next connect
 
-#include <api/RingBuffer.h>
 #include <api/Client.h>
 #include "bridge.h"
+#include "buffer_pool.h"
 
 #define DEFAULT_TCP_CLIENT_BUF_SIZE    512
 
@@ -31,16 +37,16 @@ template<size_t BufferSize=DEFAULT_TCP_CLIENT_BUF_SIZE>
 class BridgeTCPClient : public Client {
 
     BridgeClass* bridge;
-    uint32_t connection_id{};
+    atomic_t connection_id = ATOMIC_INIT(0);
     uint32_t read_timeout = 0;
-    RingBufferN<BufferSize> temp_buffer;
+    BridgeRxBuffer<BufferSize> temp_buffer;
     struct k_mutex client_mutex{};
-    bool _connected = false;
+    atomic_t _connected = ATOMIC_INIT(0);
 
 public:
     explicit BridgeTCPClient(BridgeClass& bridge): bridge(&bridge) {}
 
-    BridgeTCPClient(BridgeClass& bridge, uint32_t connection_id, bool connected=true): bridge(&bridge), connection_id(connection_id), _connected {connected} {}
+    BridgeTCPClient(BridgeClass& bridge, uint32_t connection_id, bool connected=true): bridge(&bridge), connection_id(ATOMIC_INIT(connection_id)), _connected(ATOMIC_INIT(connected)) {}
 
     bool begin() {
         k_mutex_init(&client_mutex);
@@ -65,8 +71,10 @@ public:
         k_mutex_lock(&client_mutex, K_FOREVER);
 
         String hostname = host;
-        const bool ok = _connected || bridge->call(TCP_CONNECT_METHOD, hostname, port).result(connection_id);
-        _connected = ok;
+        uint32_t id;
+        const bool ok = atomic_get(&_connected) || bridge->call(TCP_CONNECT_METHOD, hostname, port).result(id);
+        if (ok && !atomic_get(&_connected)) atomic_set(&connection_id, id);
+        atomic_set(&_connected, ok);
 
         k_mutex_unlock(&client_mutex);
 
@@ -80,18 +88,37 @@ public:
         String hostname = host;
         String ca_cert_str = ca_cert;
 
-        const bool ok = _connected || bridge->call(TCP_CONNECT_SSL_METHOD, hostname, port, ca_cert_str).result(connection_id);
-        _connected = ok;
+        uint32_t id;
+        const bool ok = atomic_get(&_connected) || bridge->call(TCP_CONNECT_SSL_METHOD, hostname, port, ca_cert_str).result(id);
+        if (ok && !atomic_get(&_connected)) atomic_set(&connection_id, id);
+        atomic_set(&_connected, ok);
         k_mutex_unlock(&client_mutex);
 
         return ok? 0 : -1;
     }
 
-    uint32_t getId() {
+    // Only the handle registered by BridgeClass::registerCA() crosses the link; the router can
+    // resume the TLS session or reuse a kept-alive connection to the same host:port
+    int connectSSL(const char *host, uint16_t port, BridgeCAHandle& ca, uint8_t options=TLS_OPT_RESUME_SESSION) {
+
+        uint32_t ca_id;
+        if (!bridge->ca_id(ca, ca_id)) return -1;
+
         k_mutex_lock(&client_mutex, K_FOREVER);
-        const uint32_t out = connection_id;
+
+        String hostname = host;
+
+        uint32_t id;
+        const bool ok = atomic_get(&_connected) || bridge->call(TCP_CONNECT_SSL_CA_METHOD, hostname, port, ca_id, options).result(id);
+        if (ok && !atomic_get(&_connected)) atomic_set(&connection_id, id);
+        atomic_set(&_connected, ok);
         k_mutex_unlock(&client_mutex);
-        return out;
+
+        return ok? 0 : -1;
+    }
+
+    uint32_t getId() const {
+        return (uint32_t)atomic_get(&connection_id);
     }
 
     size_t write(uint8_t c) override {
@@ -102,23 +129,34 @@ public:
 
         if (!connected()) return 0;
 
-        MsgPack::arr_t<uint8_t> payload;
+        k_mutex_lock(&client_mutex, K_FOREVER);
 
-        for (size_t i = 0; i < size; ++i) {
-            payload.push_back(buffer[i]);
+        // Frames are streamed straight from the caller's buffer (RAM or flash) and
+        // pipelined, so neither a copy of the payload nor a stop-and-wait per frame is needed
+        const uint32_t id = getId();
+        BridgeClass& link = bridge->bulk_link(id);
+        const size_t max_frame = link.max_frame_payload();
+        const bool use_bin = link.capability(&RouterCapabilities::bin_payloads);
+
+        BridgeStreamWriter<> stream(link, TCP_WRITE_METHOD);
+        for (size_t offset = 0; offset < size; offset += max_frame) {
+            const size_t frame_size = min(size - offset, max_frame);
+            const bool ok = use_bin?
+                stream.send_view(buffer + offset, frame_size, id) :
+                stream.send(frame_size, id, ArrayView(buffer + offset, frame_size));
+            if (!ok) break;
         }
+        const size_t total = stream.finish();
 
-        size_t written;
-        k_mutex_lock(&client_mutex, K_FOREVER);
-        const bool ok = bridge->call(TCP_WRITE_METHOD, connection_id, payload).result(written);
         k_mutex_unlock(&client_mutex);
-        return ok? written : 0;
+        return total;
     }
 
     int available() override {
         k_mutex_lock(&client_mutex, K_FOREVER);
-        const int size = temp_buffer.availableForStore();
+        const int size = (int)temp_buffer.reserve(temp_buffer.availableForStore());
         if (size > 0) _read(size);
+        temp_buffer.trim();
         const int _available = temp_buffer.available();
         k_mutex_unlock(&client_mutex);
         return _available;
@@ -130,24 +168,20 @@ public:
         return c;
     }
 
+    // Lock-free: only the fetch in available() talks to the router
     int read(uint8_t *buf, size_t size) override {
-        k_mutex_lock(&client_mutex, K_FOREVER);
-        size_t i = 0;
-        while (temp_buffer.available() && i < size) {
-            buf[i++] = temp_buffer.read_char();
-        }
-        k_mutex_unlock(&client_mutex);
-        return (int)i;
+        return (int)temp_buffer.read(buf, size);
+    }
+
+#ifdef BRIDGE_SHARED_BUFFERS
+    // Lets this buffer borrow up to bytes from the shared pool (BufferSize by default)
+    void setBufferLimit(size_t bytes) {
+        temp_buffer.setLimit(bytes);
     }
+#endif
 
     int peek() override {
-        k_mutex_lock(&client_mutex, K_FOREVER);
-        int out = -1;
-        if (temp_buffer.available()) {
-            out = temp_buffer.peek();
-        }
-        k_mutex_unlock(&client_mutex);
-        return out;
+        return temp_buffer.peek();
     }
 
     void flush() override {
@@ -161,17 +195,14 @@ public:
     void stop() override {
         k_mutex_lock(&client_mutex, K_FOREVER);
         String msg;
-        if (_connected) {
-            _connected = !bridge->call(TCP_CLOSE_METHOD, connection_id).result(msg);
+        if (atomic_get(&_connected)) {
+            atomic_set(&_connected, !bridge->call(TCP_CLOSE_METHOD, getId()).result(msg));
         }
         k_mutex_unlock(&client_mutex);
     }
 
     uint8_t connected() override {
-        k_mutex_lock(&client_mutex, K_FOREVER);
-        const uint8_t out = _connected? 1 : 0;
-        k_mutex_unlock(&client_mutex);
-        return out;
+        return atomic_get(&_connected)? 1 : 0;
     }
 
     operator bool() override {
@@ -180,6 +211,27 @@ public:
 
     using Print::write;
 
+#ifdef BRIDGE_HAS_COROUTINES
+    // Awaitable counterparts of read/write for BridgeTask coroutines. read_co fetches up
+    // to size bytes straight from the router, bypassing the read buffer. write_co sends
+    // one frame of at most max_frame_payload() bytes and yields how many were written.
+    // The bytes are packed before write_co returns, so buffer can be reused at once
+    RpcAwaitable<MsgPack::arr_t<uint8_t>> read_co(size_t size) {
+        const uint32_t id = getId();
+        return RpcAwaitable<MsgPack::arr_t<uint8_t>>(bridge->bulk_link(id), BridgeTasks, TCP_READ_METHOD, id, size);
+    }
+
+    RpcAwaitable<size_t> write_co(const uint8_t *buffer, size_t size) {
+        const uint32_t id = getId();
+        BridgeClass& link = bridge->bulk_link(id);
+        const size_t frame_size = min(size, link.max_frame_payload());
+        if (link.capability(&RouterCapabilities::bin_payloads)) {
+            return RpcAwaitable<size_t>(link, BridgeTasks, TCP_WRITE_METHOD, id, BinaryView(buffer, frame_size));
+        }
+        return RpcAwaitable<size_t>(link, BridgeTasks, TCP_WRITE_METHOD, id, ArrayView(buffer, frame_size));
+    }
+#endif
+
 private:
     void _read(size_t size) {
 
@@ -187,33 +239,32 @@ private:
 
         k_mutex_lock(&client_mutex, K_FOREVER);
 
-        if (!_connected) {
+        if (!atomic_get(&_connected)) {
             k_mutex_unlock(&client_mutex);
             return;
         }
 
+        const uint32_t connection_id = getId();
         MsgPack::arr_t<uint8_t> message;
         bool ret;
         int err;
 
         if (read_timeout > 0) {
-            RpcCall async_rpc_timeout = bridge->call(TCP_READ_METHOD, connection_id, size, read_timeout);
+            RpcCall async_rpc_timeout = bridge->bulk_link(connection_id).call(TCP_READ_METHOD, connection_id, size, read_timeout);
             ret = async_rpc_timeout.result(message);
             err = async_rpc_timeout.getErrorCode();
         } else {
-            RpcCall async_rpc = bridge->call(TCP_READ_METHOD, connection_id, size);
+            RpcCall async_rpc = bridge->bulk_link(connection_id).call(TCP_READ_METHOD, connection_id, size);
             ret = async_rpc.result(message);
             err = async_rpc.getErrorCode();
         }
 
         if (ret) {
-            for (size_t i = 0; i < message.size(); ++i) {
-                temp_buffer.store_char(static_cast<char>(message[i]));
-            }
+            temp_buffer.store(message.data(), message.size());
         }
 
         if (err > NO_ERR) {
-            _connected = false;
+            atomic_set(&_connected, 0);
         }
 
         k_mutex_unlock(&client_mutex);
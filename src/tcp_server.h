@@ -31,10 +31,10 @@ class BridgeTCPServer final: public Server {
     BridgeClass* bridge;
     IPAddress _addr{};
     uint16_t _port;
-    bool _listening = false;
+    atomic_t _listening = ATOMIC_INIT(0);
     uint32_t listener_id = 0;
-    uint32_t connection_id = 0;
-    bool _connected = false;
+    atomic_t connection_id = ATOMIC_INIT(0);
+    atomic_t _connected = ATOMIC_INIT(0);
     struct k_mutex server_mutex{};
 
 public:
@@ -50,9 +50,9 @@ public:
         }
 
         k_mutex_lock(&server_mutex, K_FOREVER);
-        if (!_listening){
+        if (!atomic_get(&_listening)){
             String hostname = _addr.toString();
-            _listening = bridge->call(TCP_LISTEN_METHOD, hostname, _port).result(listener_id);
+            atomic_set(&_listening, bridge->call(TCP_LISTEN_METHOD, hostname, _port).result(listener_id));
         }
         k_mutex_unlock(&server_mutex);
 
@@ -62,23 +62,25 @@ public:
 
         k_mutex_lock(&server_mutex, K_FOREVER);
 
-        if (!_listening) {  // Not listening -> return disconnected (invalid) client
+        if (!atomic_get(&_listening)) {  // Not listening -> return disconnected (invalid) client
             k_mutex_unlock(&server_mutex);
             return BridgeTCPClient<BufferSize>(*bridge, 0, false);
         }
 
-        if (_connected) {   // Connection already established return a client copy
+        if (atomic_get(&_connected)) {   // Connection already established return a client copy
             k_mutex_unlock(&server_mutex);
-            return BridgeTCPClient<BufferSize>(*bridge, connection_id);
+            return BridgeTCPClient<BufferSize>(*bridge, atomic_get(&connection_id));
         }
 
         // Accept a connection
-        const bool ret = bridge->call(TCP_ACCEPT_METHOD, listener_id).result(connection_id);
-        _connected = ret;
+        uint32_t id = 0;
+        const bool ret = bridge->call(TCP_ACCEPT_METHOD, listener_id).result(id);
+        if (ret) atomic_set(&connection_id, id);
+        atomic_set(&_connected, ret);
 
         k_mutex_unlock(&server_mutex);
         // If no connection established return a disconnected (invalid) client
-        return ret? BridgeTCPClient<BufferSize>(*bridge, connection_id) : BridgeTCPClient<BufferSize>(*bridge, 0, false);
+        return ret? BridgeTCPClient<BufferSize>(*bridge, id) : BridgeTCPClient<BufferSize>(*bridge, 0, false);
     }
 
     size_t write(uint8_t c) override {
@@ -92,7 +94,7 @@ public:
 
         k_mutex_lock(&server_mutex, K_FOREVER);
         size_t written = 0;
-        if (_connected) {
+        if (atomic_get(&_connected)) {
             written = client.write(buf, size);
         }
         k_mutex_unlock(&server_mutex);
@@ -102,8 +104,8 @@ public:
     void close() {
         k_mutex_lock(&server_mutex, K_FOREVER);
         String msg;
-        if (_listening){
-            _listening = !bridge->call(TCP_CLOSE_LISTENER_METHOD, listener_id).result(msg);
+        if (atomic_get(&_listening)){
+            atomic_set(&_listening, !bridge->call(TCP_CLOSE_LISTENER_METHOD, listener_id).result(msg));
             // Debug msg?
         }
         k_mutex_unlock(&server_mutex);
@@ -111,37 +113,26 @@ public:
 
     void disconnect() {
         k_mutex_lock(&server_mutex, K_FOREVER);
-        _connected = false;
-        connection_id = 0;
+        atomic_set(&_connected, 0);
+        atomic_set(&connection_id, 0);
         k_mutex_unlock(&server_mutex);
     }
 
-    bool is_listening() {
-        k_mutex_lock(&server_mutex, K_FOREVER);
-        bool out = _listening;
-        k_mutex_unlock(&server_mutex);
-        return out;
+    bool is_listening() const {
+        return atomic_get(&_listening);
     }
 
-    bool is_connected() {
-        k_mutex_lock(&server_mutex, K_FOREVER);
-        bool out = _connected;
-        k_mutex_unlock(&server_mutex);
-        return out;
+    bool is_connected() const {
+        return atomic_get(&_connected);
     }
 
-    uint16_t getPort() {
-        k_mutex_lock(&server_mutex, K_FOREVER);
-        uint16_t port = _port;
-        k_mutex_unlock(&server_mutex);
-        return port;
+    // _addr and _port are only set at construction
+    uint16_t getPort() const {
+        return _port;
     }
 
-    String getAddr() {
-        k_mutex_lock(&server_mutex, K_FOREVER);
-        String hostname = _addr.toString();
-        k_mutex_unlock(&server_mutex);
-        return hostname;
+    String getAddr() const {
+        return _addr.toString();
     }
 
     operator bool() const {
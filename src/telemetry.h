@@ -0,0 +1,214 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_TELEMETRY_H
+#define BRIDGE_TELEMETRY_H
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include "tx_queue.h"
+
+// FNV-1a, to compare slot names quickly
+constexpr uint32_t bridge_hash(const char* s) {
+    uint32_t h = 2166136261u;
+    while (*s) {
+        h = (h ^ static_cast<uint8_t>(*s++)) * 16777619u;
+    }
+    return h;
+}
+
+// Methods (or method and key pairs) sent with notify_latest at the same time
+#ifndef BRIDGE_TELEMETRY_SLOTS
+#define BRIDGE_TELEMETRY_SLOTS          8
+#endif
+
+// Longest method name, terminator included
+#ifndef BRIDGE_TELEMETRY_NAME_SIZE
+#define BRIDGE_TELEMETRY_NAME_SIZE      24
+#endif
+
+// Send interval of methods not set up with BridgeClass::telemetry
+#ifndef BRIDGE_TELEMETRY_INTERVAL_MS
+#define BRIDGE_TELEMETRY_INTERVAL_MS    100
+#endif
+
+// What a telemetry notification carries about the values of its interval
+enum BridgeAggregate : uint8_t {
+    TELEMETRY_LATEST = 0,   // the last value
+    TELEMETRY_MIN,
+    TELEMETRY_MAX,
+    TELEMETRY_MEAN,
+    TELEMETRY_STATS         // min, max, mean, count
+};
+
+// Latest-value notifications: an update overwrites, or is folded into, the one not sent yet,
+// and each method (or method and key) goes out at most once per interval. Slots live in a
+// fixed table behind a spinlock, so updates are ISR-safe. The writer thread sends the due
+// ones through the outbound queue
+class BridgeTelemetry {
+
+    struct Slot {
+        char method[BRIDGE_TELEMETRY_NAME_SIZE];
+        uint32_t hash;
+        uint32_t key;
+        bool keyed;
+        bool used;
+        uint8_t aggregate;
+        uint32_t interval;
+        int64_t next_send;
+        uint32_t count;         // updates since the last send
+        double latest, min, max, sum;
+    };
+
+    Slot slots[BRIDGE_TELEMETRY_SLOTS]{};
+    struct k_spinlock lock{};
+
+    // Must hold the lock. nullptr when the table is full or the name too long
+    Slot* find(const char* method, uint32_t key, bool keyed, bool create) {
+        const uint32_t hash = bridge_hash(method);
+        Slot* free_slot = nullptr;
+        for (Slot& slot : slots) {
+            if (!slot.used) {
+                if (!free_slot) free_slot = &slot;
+                continue;
+            }
+            if (slot.hash == hash && slot.keyed == keyed && slot.key == key && strcmp(slot.method, method) == 0) {
+                return &slot;
+            }
+        }
+        if (!create || !free_slot || strlen(method) >= BRIDGE_TELEMETRY_NAME_SIZE) return nullptr;
+
+        strcpy(free_slot->method, method);
+        free_slot->hash = hash;
+        free_slot->key = key;
+        free_slot->keyed = keyed;
+        free_slot->used = true;
+        free_slot->aggregate = TELEMETRY_LATEST;
+        free_slot->interval = BRIDGE_TELEMETRY_INTERVAL_MS;
+        free_slot->next_send = 0;
+        free_slot->count = 0;
+        return free_slot;
+    }
+
+    static bool encode(BridgeFrameEncoder& frame, const Slot& s) {
+        const uint8_t values = s.aggregate == TELEMETRY_STATS ? 4 : 1;
+        frame.packArraySize(3);
+        frame.pack(static_cast<uint8_t>(NOTIFY_MSG));
+        frame.pack(s.method);
+        frame.packArraySize(values + (s.keyed ? 1 : 0));
+        if (s.keyed) frame.pack(s.key);
+        switch (s.aggregate) {
+            case TELEMETRY_MIN: frame.pack(s.min); break;
+            case TELEMETRY_MAX: frame.pack(s.max); break;
+            case TELEMETRY_MEAN: frame.pack(s.sum / s.count); break;
+            case TELEMETRY_STATS:
+                frame.pack(s.min);
+                frame.pack(s.max);
+                frame.pack(s.sum / s.count);
+                frame.pack(s.count);
+                break;
+            default: frame.pack(s.latest); break;
+        }
+        return frame.ok();
+    }
+
+public:
+
+    bool configure(const char* method, uint32_t key, bool keyed, uint32_t interval_ms, BridgeAggregate aggregate) {
+        k_spinlock_key_t k = k_spin_lock(&lock);
+        Slot* slot = find(method, key, keyed, true);
+        if (slot) {
+            slot->interval = interval_ms;
+            slot->aggregate = aggregate;
+        }
+        k_spin_unlock(&lock, k);
+        return slot != nullptr;
+    }
+
+    // Returns false when the value could not be kept. due is set when the slot may be sent now
+    bool update(const char* method, uint32_t key, bool keyed, double value, bool& due) {
+        k_spinlock_key_t k = k_spin_lock(&lock);
+        Slot* slot = find(method, key, keyed, true);
+        if (slot) {
+            if (slot->count == 0) {
+                slot->min = slot->max = slot->sum = value;
+            } else {
+                if (value < slot->min) slot->min = value;
+                if (value > slot->max) slot->max = value;
+                slot->sum += value;
+            }
+            slot->latest = value;
+            slot->count++;
+            due = k_uptime_get() >= slot->next_send;
+        }
+        k_spin_unlock(&lock, k);
+        return slot != nullptr;
+    }
+
+    // Writer thread: queues every due slot. Returns when the next pending one is due, 0 if none
+    int64_t flush(BridgeTxQueue& tx) {
+        const int64_t now = k_uptime_get();
+        int64_t next = 0;
+        for (Slot& slot : slots) {
+            k_spinlock_key_t k = k_spin_lock(&lock);
+            if (!slot.used || slot.count == 0) {
+                k_spin_unlock(&lock, k);
+                continue;
+            }
+            if (now < slot.next_send) {
+                if (next == 0 || slot.next_send < next) next = slot.next_send;
+                k_spin_unlock(&lock, k);
+                continue;
+            }
+            const Slot snapshot = slot;
+            slot.count = 0;
+            slot.next_send = now + slot.interval;
+            k_spin_unlock(&lock, k);
+
+            const int index = tx.try_take();
+            if (index < 0) {
+                // every frame is in flight: fold the values back and retry soon
+                k = k_spin_lock(&lock);
+                if (slot.count == 0) {
+                    slot.min = snapshot.min;
+                    slot.max = snapshot.max;
+                    slot.sum = snapshot.sum;
+                    slot.latest = snapshot.latest;
+                } else {
+                    if (snapshot.min < slot.min) slot.min = snapshot.min;
+                    if (snapshot.max > slot.max) slot.max = snapshot.max;
+                    slot.sum += snapshot.sum;
+                }
+                slot.count += snapshot.count;
+                slot.next_send = now + 1;
+                k_spin_unlock(&lock, k);
+                if (next == 0 || now + 1 < next) next = now + 1;
+                continue;
+            }
+
+            BridgeFrameEncoder frame(tx.data(index), BridgeTxQueue::capacity());
+            if (encode(frame, snapshot)) {
+                tx.post(index, frame.size(), RPC_PRIORITY_NORMAL);
+            } else {
+                tx.release(index);
+            }
+            if (slot.interval > 0 && (next == 0 || now + slot.interval < next)) {
+                next = now + slot.interval;
+            }
+        }
+        return next;
+    }
+
+};
+
+#endif // BRIDGE_TELEMETRY_H
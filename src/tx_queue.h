@@ -0,0 +1,328 @@
+/*
+    This file is part of the Arduino_RouterBridge library.
+
+    Copyright (c) 2025 Arduino SA
+
+    This Source Code Form is subject to the terms of the Mozilla Public
+    License, v. 2.0. If a copy of the MPL was not distributed with this
+    file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+*/
+
+#pragma once
+
+#ifndef BRIDGE_TX_QUEUE_H
+#define BRIDGE_TX_QUEUE_H
+
+#include <string.h>
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <Arduino_RPClite.h>
+#include <type_traits>
+
+// Encoded messages waiting for the writer thread. A power of two, at most 32
+#ifndef BRIDGE_TX_FRAMES
+#define BRIDGE_TX_FRAMES        16
+#endif
+
+// Bigger messages are written by the sender itself, holding the write lock
+#ifndef BRIDGE_TX_FRAME_SIZE
+#define BRIDGE_TX_FRAME_SIZE    128
+#endif
+
+// Outbound traffic classes. Lower value wins the link first
+enum RpcPriority : uint8_t {
+    RPC_PRIORITY_REALTIME = 0,  // HCI, provide() responses
+    RPC_PRIORITY_NORMAL,        // default for call() and notify()
+    RPC_PRIORITY_BULK,          // tcp/udp payload frames
+    RPC_PRIORITY_COUNT
+};
+
+// Bounded lock-free FIFO of small values, many producers (threads and ISRs) and one
+// consumer. Each cell carries a sequence number telling whose turn it is
+template<size_t N>
+class BridgeIndexRing {
+
+    static_assert(N > 0 && (N & (N - 1)) == 0, "BridgeIndexRing size must be a power of two");
+
+    struct Cell {
+        atomic_t seq;
+        uint8_t value;
+    };
+
+    Cell cells[N];
+    atomic_t enqueue_pos = ATOMIC_INIT(0);
+    atomic_t dequeue_pos = ATOMIC_INIT(0);
+
+public:
+
+    BridgeIndexRing() {
+        for (size_t i = 0; i < N; i++) {
+            atomic_set(&cells[i].seq, i);
+            cells[i].value = 0;
+        }
+    }
+
+    // Never waits, false when full
+    bool push(uint8_t value) {
+        atomic_val_t pos = atomic_get(&enqueue_pos);
+        while (true) {
+            Cell& cell = cells[pos & (N - 1)];
+            const atomic_val_t dif = atomic_get(&cell.seq) - pos;
+            if (dif == 0) {
+                if (atomic_cas(&enqueue_pos, pos, pos + 1)) {
+                    cell.value = value;
+                    atomic_set(&cell.seq, pos + 1);
+                    return true;
+                }
+            } else if (dif < 0) {
+                return false;
+            }
+            pos = atomic_get(&enqueue_pos);
+        }
+    }
+
+    // Consumer side. False when empty, or when the oldest push is not complete yet
+    bool pop(uint8_t& value) {
+        const atomic_val_t pos = atomic_get(&dequeue_pos);
+        Cell& cell = cells[pos & (N - 1)];
+        if (atomic_get(&cell.seq) != pos + 1) return false;
+        value = cell.value;
+        atomic_set(&dequeue_pos, pos + 1);
+        atomic_set(&cell.seq, pos + N);
+        return true;
+    }
+
+};
+
+// Packs msgpack straight into a fixed buffer: no heap, so it runs in an ISR.
+// Knows scalars and strings only. ok() is false once something did not fit
+class BridgeFrameEncoder {
+
+    uint8_t* buffer;
+    size_t capacity;
+    size_t length = 0;
+    bool fits = true;
+
+    void put(uint8_t b) {
+        put(&b, 1);
+    }
+
+    void put(const void* data, size_t size) {
+        if (!fits || length + size > capacity) {
+            fits = false;
+            return;
+        }
+        memcpy(buffer + length, data, size);
+        length += size;
+    }
+
+    void put_be(uint8_t type, uint64_t value, size_t bytes) {
+        uint8_t out[9];
+        out[0] = type;
+        for (size_t i = 0; i < bytes; i++) {
+            out[bytes - i] = static_cast<uint8_t>(value >> (8 * i));
+        }
+        put(out, bytes + 1);
+    }
+
+    void pack_unsigned(uint64_t v) {
+        if (v < 0x80) put(static_cast<uint8_t>(v));
+        else if (v <= 0xFF) put_be(0xCC, v, 1);
+        else if (v <= 0xFFFF) put_be(0xCD, v, 2);
+        else if (v <= 0xFFFFFFFFu) put_be(0xCE, v, 4);
+        else put_be(0xCF, v, 8);
+    }
+
+    void pack_signed(int64_t v) {
+        if (v >= 0) pack_unsigned(static_cast<uint64_t>(v));
+        else if (v >= -32) put(static_cast<uint8_t>(v));
+        else if (v >= INT8_MIN) put_be(0xD0, static_cast<uint64_t>(v), 1);
+        else if (v >= INT16_MIN) put_be(0xD1, static_cast<uint64_t>(v), 2);
+        else if (v >= INT32_MIN) put_be(0xD2, static_cast<uint64_t>(v), 4);
+        else put_be(0xD3, static_cast<uint64_t>(v), 8);
+    }
+
+public:
+
+    BridgeFrameEncoder(uint8_t* b, size_t c): buffer(b), capacity(c) {}
+
+    bool ok() const {
+        return fits;
+    }
+
+    size_t size() const {
+        return length;
+    }
+
+    void packArraySize(size_t n) {
+        if (n < 16) put(static_cast<uint8_t>(0x90 | n));
+        else put_be(0xDC, n, 2);
+    }
+
+    void pack(std::nullptr_t) {
+        put(0xC0);
+    }
+
+    void pack(bool v) {
+        put(v ? 0xC3 : 0xC2);
+    }
+
+    template<typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T, bool>::value, int>::type = 0>
+    void pack(T v) {
+        if (std::is_signed<T>::value) pack_signed(static_cast<int64_t>(v));
+        else pack_unsigned(static_cast<uint64_t>(v));
+    }
+
+    void pack(float v) {
+        uint32_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        put_be(0xCA, bits, 4);
+    }
+
+    void pack(double v) {
+        uint64_t bits;
+        memcpy(&bits, &v, sizeof(bits));
+        put_be(0xCB, bits, 8);
+    }
+
+    void pack(const char* s) {
+        pack(s, strlen(s));
+    }
+
+    void pack(const char* s, size_t n) {
+        if (n < 32) put(static_cast<uint8_t>(0xA0 | n));
+        else if (n <= 0xFF) put_be(0xD9, n, 1);
+        else put_be(0xDA, n, 2);
+        put(s, n);
+    }
+
+};
+
+// Pool of encoded frames and one FIFO per priority, drained by a single writer.
+// Taking, filling and posting a frame is lock-free and never waits, so ISRs can send
+class BridgeTxQueue {
+
+    static_assert(BRIDGE_TX_FRAMES <= 32, "BRIDGE_TX_FRAMES must be at most 32");
+
+    struct Frame {
+        uint16_t size;
+        uint8_t data[BRIDGE_TX_FRAME_SIZE];
+    };
+
+    Frame frames[BRIDGE_TX_FRAMES];
+    atomic_t in_use = ATOMIC_INIT(0);                   // one bit per frame
+    BridgeIndexRing<BRIDGE_TX_FRAMES> queued[RPC_PRIORITY_COUNT];
+    atomic_t posted[RPC_PRIORITY_COUNT]{};             // frames handed to the writer so far
+    atomic_t written[RPC_PRIORITY_COUNT]{};            // and the ones it has sent
+    struct k_sem ready{};       // wakes the writer
+    struct k_sem freed{};       // wakes senders waiting for a frame
+
+    bool pop(int& index, RpcPriority& priority) {
+        for (uint8_t p = 0; p < RPC_PRIORITY_COUNT; p++) {
+            uint8_t i;
+            if (queued[p].pop(i)) {
+                index = i;
+                priority = static_cast<RpcPriority>(p);
+                return true;
+            }
+        }
+        return false;
+    }
+
+public:
+
+    void init() {
+        k_sem_init(&ready, 0, 1);
+        k_sem_init(&freed, 0, BRIDGE_TX_FRAMES);
+    }
+
+    // Lock-free. -1 when every frame is taken
+    int try_take() {
+        while (true) {
+            const atomic_val_t used = atomic_get(&in_use);
+            int index = -1;
+            for (int i = 0; i < BRIDGE_TX_FRAMES; i++) {
+                if (!(used & (1ul << i))) {
+                    index = i;
+                    break;
+                }
+            }
+            if (index < 0) return -1;
+            if (atomic_cas(&in_use, used, used | (1ul << index))) return index;
+        }
+    }
+
+    // Thread side: waits for a frame until deadline (absolute k_uptime_get() value, 0 waits forever)
+    int take(const int64_t deadline) {
+        while (true) {
+            const int index = try_take();
+            if (index >= 0) return index;
+            const int64_t now = k_uptime_get();
+            if (deadline > 0 && now >= deadline) return -1;
+            k_sem_take(&freed, deadline > 0 ? K_MSEC(deadline - now) : K_FOREVER);
+        }
+    }
+
+    uint8_t* data(int index) {
+        return frames[index].data;
+    }
+
+    static constexpr size_t capacity() {
+        return BRIDGE_TX_FRAME_SIZE;
+    }
+
+    // Hands the frame to the writer. ISR-safe
+    void post(int index, size_t size, RpcPriority priority) {
+        frames[index].size = static_cast<uint16_t>(size);
+        atomic_inc(&posted[priority]);
+        // cannot fail: a queue has room for every frame
+        queued[priority].push(static_cast<uint8_t>(index));
+        k_sem_give(&ready);
+    }
+
+    // Gives back a frame that was taken and not posted. ISR-safe
+    void release(int index) {
+        atomic_and(&in_use, ~(1ul << index));
+        k_sem_give(&freed);
+    }
+
+    // Writer side: frees a frame once it is on the link
+    void sent(int index, RpcPriority priority) {
+        atomic_inc(&written[priority]);
+        release(index);
+    }
+
+    // Frames posted at priority so far, for sent_up_to()
+    atomic_val_t mark(RpcPriority priority) const {
+        return atomic_get(&posted[priority]);
+    }
+
+    // True once the writer sent the frames of priority posted before mark() returned m.
+    // A priority is drained in order, so any frame past those was posted later
+    bool sent_up_to(RpcPriority priority, atomic_val_t m) const {
+        const uint32_t ahead = static_cast<uint32_t>(atomic_get(&written[priority])) - static_cast<uint32_t>(m);
+        return static_cast<int32_t>(ahead) >= 0;
+    }
+
+    // Writer side: the most urgent queued frame. Waits up to timeout for one, and returns
+    // false early if woken with nothing queued
+    bool next(int& index, RpcPriority& priority, k_timeout_t timeout) {
+        if (pop(index, priority)) return true;
+        if (k_sem_take(&ready, timeout) != 0) return false;
+        return pop(index, priority);
+    }
+
+    // Has the writer look at its other work. ISR-safe
+    void wake() {
+        k_sem_give(&ready);
+    }
+
+    const uint8_t* frame(int index, size_t& size) const {
+        size = frames[index].size;
+        return frames[index].data;
+    }
+
+};
+
+#endif // BRIDGE_TX_QUEUE_H
@@ -25,6 +25,8 @@ This file is part of the Arduino_RouterBridge library.
 #define UDP_DROP_PACKET_METHOD      "udp/dropPacket"
 
 #include <api/Udp.h>
+#include "bridge.h"
+#include "buffer_pool.h"
 
 #define DEFAULT_UDP_BUF_SIZE    4096
 
@@ -49,9 +51,9 @@ class BridgeUDP final: public UDP {
     BridgeClass* bridge;
     uint32_t connection_id{};
     uint32_t read_timeout = 1;
-    RingBufferN<BufferSize> temp_buffer;
+    BridgeRxBuffer<BufferSize> temp_buffer;
     struct k_mutex udp_mutex{};
-    bool _connected = false;
+    atomic_t _connected = ATOMIC_INIT(0);
 
     uint16_t _port{}; // local port to listen on
 
@@ -61,8 +63,8 @@ class BridgeUDP final: public UDP {
 
     // Inbound packet info
     IPAddress _remoteIP{}; // remote IP address for the incoming packet whilst it's being processed
-    uint16_t _remotePort{}; // remote port for the incoming packet whilst it's being processed
-    uint16_t _remaining{}; // remaining bytes of incoming packet yet to be processed
+    atomic_t _remotePort = ATOMIC_INIT(0); // remote port for the incoming packet whilst it's being processed
+    atomic_t _remaining = ATOMIC_INIT(0); // remaining bytes of incoming packet yet to be processed
     BridgeUdpMeta packet_meta{};
 
 public:
@@ -77,11 +79,11 @@ public:
         k_mutex_lock(&udp_mutex, K_FOREVER);
 
         bool ok = false;
-        if (!_connected) {
+        if (!atomic_get(&_connected)) {
             String hostname = "0.0.0.0";
             ok = bridge->call(UDP_CONNECT_METHOD, hostname, port).result(connection_id);
-            _connected = ok;
-            if (_connected) _port = port;
+            atomic_set(&_connected, ok);
+            if (ok) _port = port;
         }
 
         k_mutex_unlock(&udp_mutex);
@@ -105,11 +107,11 @@ public:
         k_mutex_lock(&udp_mutex, K_FOREVER);
 
         bool ok = false;
-        if (!_connected) {
+        if (!atomic_get(&_connected)) {
             String hostname = "0.0.0.0";
             ok = bridge->call(UDP_CONNECT_METHOD, hostname, port).result(connection_id);
-            _connected = ok;
-            if (_connected) _port = port;
+            atomic_set(&_connected, ok);
+            if (ok) _port = port;
         }
 
         k_mutex_unlock(&udp_mutex);
@@ -120,9 +122,9 @@ public:
     void stop() override {
         k_mutex_lock(&udp_mutex, K_FOREVER);
 
-        if (_connected) {
+        if (atomic_get(&_connected)) {
             String msg;
-            _connected = !bridge->call(UDP_CLOSE_METHOD, connection_id).result(msg);
+            atomic_set(&_connected, !bridge->call(UDP_CLOSE_METHOD, connection_id).result(msg));
         }
 
         k_mutex_unlock(&udp_mutex);
@@ -173,18 +175,27 @@ public:
     size_t write(const uint8_t *buffer, size_t size) override {
         if (!connected()) return 0;
 
-        MsgPack::arr_t<uint8_t> payload;
+        k_mutex_lock(&udp_mutex, K_FOREVER);
 
-        for (size_t i = 0; i < size; ++i) {
-            payload.push_back(buffer[i]);
+        // The router appends to the pending packet, so it can be sent in bounded frames,
+        // streamed from the caller's buffer (RAM or flash) without a copy
+        BridgeClass& link = bridge->bulk_link(connection_id);
+        const size_t max_frame = link.max_frame_payload();
+        const bool use_bin = link.capability(&RouterCapabilities::bin_payloads);
+
+        BridgeStreamWriter<> stream(link, UDP_WRITE_METHOD);
+        for (size_t offset = 0; offset < size; offset += max_frame) {
+            const size_t frame_size = min(size - offset, max_frame);
+            const bool ok = use_bin?
+                stream.send_view(buffer + offset, frame_size, connection_id) :
+                stream.send(frame_size, connection_id, ArrayView(buffer + offset, frame_size));
+            if (!ok) break;
         }
+        const size_t total = stream.finish();
 
-        size_t written;
-        k_mutex_lock(&udp_mutex, K_FOREVER);
-        const bool ok = bridge->call(UDP_WRITE_METHOD, connection_id, payload).result(written);
         k_mutex_unlock(&udp_mutex);
 
-        return ok? written : 0;
+        return total;
     }
 
     using Print::write;
@@ -196,15 +207,15 @@ public:
 
         int out = 0;
 
-        const bool ret = _connected && bridge->call(UDP_AWAIT_PACKET_METHOD, connection_id, read_timeout).result(packet_meta);
+        const bool ret = atomic_get(&_connected) && bridge->call(UDP_AWAIT_PACKET_METHOD, connection_id, read_timeout).result(packet_meta);
 
         if (ret) {
             if (!_remoteIP.fromString(packet_meta.host)) {
                 _remoteIP.fromString("0.0.0.0");
             }
-            _remotePort = packet_meta.port;
-            _remaining = packet_meta.size;
-            out = _remaining;
+            atomic_set(&_remotePort, packet_meta.port);
+            atomic_set(&_remaining, packet_meta.size);
+            out = packet_meta.size;
         }
 
         k_mutex_unlock(&udp_mutex);
@@ -218,12 +229,12 @@ public:
         bool ok=false;
 
         k_mutex_lock(&udp_mutex, K_FOREVER);
-        if (_remaining > temp_buffer.available()) {
+        if (atomic_get(&_remaining) > temp_buffer.available()) {
             bool res = false;
             ok = bridge->call(UDP_DROP_PACKET_METHOD, connection_id).result(res) && res;
         }
 
-        _remaining = 0;
+        atomic_set(&_remaining, 0);
         temp_buffer.clear();
         k_mutex_unlock(&udp_mutex);
 
@@ -232,8 +243,9 @@ public:
 
     int available() override {
         k_mutex_lock(&udp_mutex, K_FOREVER);
-        const int size = temp_buffer.availableForStore();
+        const int size = (int)temp_buffer.reserve(temp_buffer.availableForStore());
         if (size > 0) _read(size);
+        temp_buffer.trim();
         const int _available = temp_buffer.available();
         k_mutex_unlock(&udp_mutex);
         return _available;
@@ -246,44 +258,37 @@ public:
     }
 
     // reading stops when the UDP package has been read completely (_remaining = 0)
+    // Buffered bytes are consumed lock-free, the mutex is only taken to fetch more
     int read(unsigned char *buffer, size_t len) override {
-        k_mutex_lock(&udp_mutex, K_FOREVER);
-       	size_t i = 0;
-        while (_remaining && i < len) {
-            if (!temp_buffer.available() && !available()) {
-                k_msleep(1);
+        size_t i = 0;
+        while (i < len) {
+            const size_t remaining = atomic_get(&_remaining);
+            if (remaining == 0) break;
+            const size_t n = temp_buffer.read(buffer + i, min(len - i, remaining));
+            if (n == 0) {
+                if (!available()) k_msleep(1);
                 continue;
             }
-            buffer[i++] = temp_buffer.read_char();
-            _remaining--;
+            atomic_sub(&_remaining, n);
+            i += n;
         }
-        k_mutex_unlock(&udp_mutex);
         return (int)i;
     }
 
     int read(char *buffer, size_t len) override {
-        k_mutex_lock(&udp_mutex, K_FOREVER);
-        size_t i = 0;
-        while (_remaining && i < len) {
-            if (!temp_buffer.available() && !available()) {
-                k_msleep(1);
-                continue;
-            }
-            buffer[i++] = static_cast<char>(temp_buffer.read_char());
-            _remaining--;
-        }
-        k_mutex_unlock(&udp_mutex);
-        return (int)i;
+        return read(reinterpret_cast<unsigned char*>(buffer), len);
     }
 
+#ifdef BRIDGE_SHARED_BUFFERS
+    // Lets this buffer borrow up to bytes from the shared pool (BufferSize by default)
+    void setBufferLimit(size_t bytes) {
+        temp_buffer.setLimit(bytes);
+    }
+#endif
+
     int peek() override {
-        k_mutex_lock(&udp_mutex, K_FOREVER);
-        int out = -1;
-        if (_remaining && temp_buffer.available()) {
-            out = temp_buffer.peek();
-        }
-        k_mutex_unlock(&udp_mutex);
-        return out;
+        if (!atomic_get(&_remaining)) return -1;
+        return temp_buffer.peek();
     }
 
     void flush() override {
@@ -298,19 +303,36 @@ public:
     }
 
     uint16_t remotePort() override {
-        k_mutex_lock(&udp_mutex, K_FOREVER);
-        const uint16_t port = _remotePort;
-        k_mutex_unlock(&udp_mutex);
-        return port;
+        return (uint16_t)atomic_get(&_remotePort);
     }
 
-    bool connected() {
-        k_mutex_lock(&udp_mutex, K_FOREVER);
-        const bool ok = _connected;
-        k_mutex_unlock(&udp_mutex);
-        return ok;
+    bool connected() const {
+        return atomic_get(&_connected);
     }
 
+    uint32_t getId() const {
+        return connection_id;
+    }
+
+#ifdef BRIDGE_HAS_COROUTINES
+    // Awaitable counterparts of read/write for BridgeTask coroutines. read_co fetches up to
+    // size bytes of the current packet straight from the router: do not mix it with read()
+    // on the same packet. write_co appends one frame of at most max_frame_payload() bytes
+    // to the packet being built and yields how many were written
+    RpcAwaitable<MsgPack::arr_t<uint8_t>> read_co(size_t size) {
+        return RpcAwaitable<MsgPack::arr_t<uint8_t>>(bridge->bulk_link(connection_id), BridgeTasks, UDP_READ_METHOD, connection_id, size, read_timeout);
+    }
+
+    RpcAwaitable<size_t> write_co(const uint8_t *buffer, size_t size) {
+        BridgeClass& link = bridge->bulk_link(connection_id);
+        const size_t frame_size = min(size, link.max_frame_payload());
+        if (link.capability(&RouterCapabilities::bin_payloads)) {
+            return RpcAwaitable<size_t>(link, BridgeTasks, UDP_WRITE_METHOD, connection_id, BinaryView(buffer, frame_size));
+        }
+        return RpcAwaitable<size_t>(link, BridgeTasks, UDP_WRITE_METHOD, connection_id, ArrayView(buffer, frame_size));
+    }
+#endif
+
 private:
 
     bool init() {
@@ -327,12 +349,10 @@ private:
         k_mutex_lock(&udp_mutex, K_FOREVER);
 
         MsgPack::arr_t<uint8_t> message;
-        const bool ret = _connected && bridge->call(UDP_READ_METHOD, connection_id, size, read_timeout).result(message);
+        const bool ret = atomic_get(&_connected) && bridge->bulk_link(connection_id).call(UDP_READ_METHOD, connection_id, size, read_timeout).result(message);
 
         if (ret) {
-            for (size_t i = 0; i < message.size(); ++i) {
-                temp_buffer.store_char(static_cast<char>(message[i]));
-            }
+            temp_buffer.store(message.data(), message.size());
         }
 
         k_mutex_unlock(&udp_mutex);